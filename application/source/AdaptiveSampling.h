@@ -0,0 +1,130 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  AdaptiveSampling.h
+ *  @brief Spread a budget of multicell samples unevenly across genotypes, where it matters most.
+ *  @note Status: BETA
+ *
+ *  A uniform library gives every genotype the same number of samples, but fill-time
+ *  distributions only change sharply near the restraint threshold; far from it they are narrow
+ *  and nearly identical between neighbors.  Given a small pilot sample of every genotype (in
+ *  order of ones), each is weighted by
+ *    - its coefficient of variation (sd / mean), since allocating in proportion to it minimizes
+ *      the summed squared relative error of the genotypes' mean fill times; plus
+ *    - the largest Kolmogorov-Smirnov distance to a neighboring genotype, since selection acts
+ *      on the differences between neighbors.  Only the part of the distance beyond what
+ *      sampling noise alone would give (its 95% critical value) counts; small pilots of
+ *      identical distributions are often 0.2 or more apart.
+ *  The budget left after the pilots is split in proportion to these weights, capped at a
+ *  maximum per genotype.
+ */
+
+#ifndef ADAPTIVE_SAMPLING_H
+#define ADAPTIVE_SAMPLING_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "emp/base/vector.hpp"
+
+namespace AdaptiveSampling {
+
+  /// Largest difference between the empirical distribution functions of two sample sets.
+  inline double CalcKSDistance(emp::vector<double> a, emp::vector<double> b) {
+    if (a.empty() || b.empty()) return 0.0;
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    size_t i = 0, j = 0;
+    double max_diff = 0.0;
+    while (i < a.size() && j < b.size()) {
+      const double x = std::min(a[i], b[j]);
+      while (i < a.size() && a[i] == x) i++;
+      while (j < b.size() && b[j] == x) j++;
+      max_diff = std::max(max_diff, std::abs((double) i / a.size() - (double) j / b.size()));
+    }
+    return max_diff;
+  }
+
+  /// KS distance that two sample sets of these sizes exceed by chance only 5% of the time.
+  inline double CalcKSCritical(size_t size_a, size_t size_b) {
+    return 1.36 * std::sqrt((double) (size_a + size_b) / (double) (size_a * size_b));
+  }
+
+  /// Coefficient of variation of a sample set (0 if it is too small to tell).
+  inline double CalcCV(const emp::vector<double> & samples) {
+    if (samples.size() < 2) return 0.0;
+    double mean = 0.0;
+    for (double sample : samples) mean += sample;
+    mean /= samples.size();
+    double var = 0.0;
+    for (double sample : samples) var += (sample - mean) * (sample - mean);
+    var /= samples.size() - 1;
+    return mean > 0.0 ? std::sqrt(var) / mean : 0.0;
+  }
+
+  struct Weight {
+    double cv = 0.0;             ///< Coefficient of variation of the pilot samples.
+    double neighbor_dist = 0.0;  ///< Largest KS distance to a neighbor, beyond sampling noise.
+    double GetTotal() const { return cv + neighbor_dist; }
+  };
+
+  /// Weights for pilot samples of consecutive genotypes.
+  inline emp::vector<Weight> CalcWeights(const emp::vector<emp::vector<double>> & pilots) {
+    emp::vector<Weight> weights(pilots.size());
+    for (size_t i = 0; i < pilots.size(); i++) {
+      weights[i].cv = CalcCV(pilots[i]);
+      if (i > 0 && pilots[i-1].size() && pilots[i].size()) {
+        const double dist = std::max(0.0, CalcKSDistance(pilots[i-1], pilots[i]) -
+                                          CalcKSCritical(pilots[i-1].size(), pilots[i].size()));
+        weights[i-1].neighbor_dist = std::max(weights[i-1].neighbor_dist, dist);
+        weights[i].neighbor_dist = std::max(weights[i].neighbor_dist, dist);
+      }
+    }
+    return weights;
+  }
+
+  /// Sample counts for each genotype: pilot_size each, plus the rest of budget in proportion
+  /// to the weights, with none above max_samples.  Counts sum to the budget, except that every
+  /// genotype always keeps its pilot samples (so the sum is larger if the pilots alone exceed
+  /// the budget) and none goes above max_samples (so the sum is smaller if the budget exceeds
+  /// max_samples for every genotype).
+  inline emp::vector<size_t> Allocate(const emp::vector<Weight> & weights, size_t pilot_size,
+                                      size_t budget, size_t max_samples) {
+    const size_t num = weights.size();
+    emp::vector<size_t> counts(num, std::min(pilot_size, max_samples));
+    size_t remaining = budget;
+    for (size_t count : counts) remaining -= std::min(remaining, count);
+
+    // Split what remains among genotypes below the cap; repeat while caps cut shares short.
+    while (remaining > 0) {
+      double total_weight = 0.0;
+      size_t num_open = 0;
+      for (size_t i = 0; i < num; i++) {
+        if (counts[i] < max_samples) { total_weight += weights[i].GetTotal(); num_open++; }
+      }
+      if (num_open == 0) break;
+      size_t given = 0;
+      for (size_t i = 0; i < num; i++) {
+        if (counts[i] >= max_samples) continue;
+        const double share = total_weight > 0.0 ? weights[i].GetTotal() / total_weight : 1.0 / num_open;
+        const size_t extra = std::min(max_samples - counts[i], (size_t) (share * remaining));
+        counts[i] += extra;
+        given += extra;
+      }
+      remaining -= given;
+      if (given == 0) {          // Shares rounded down to nothing; hand out the rest by weight.
+        emp::vector<size_t> order;
+        for (size_t i = 0; i < num; i++) if (counts[i] < max_samples) order.push_back(i);
+        std::stable_sort(order.begin(), order.end(), [&weights](size_t a, size_t b){
+          return weights[a].GetTotal() > weights[b].GetTotal();
+        });
+        for (size_t i = 0; remaining > 0 && i < order.size(); i++, remaining--) counts[order[i]]++;
+      }
+    }
+    return counts;
+  }
+
+}
+
+#endif
@@ -0,0 +1,332 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  ApproxEngine.h
+ *  @brief Approximate simulation of a multicell in fixed time windows (-A).
+ *  @note Status: BETA
+ *
+ *  Rather than replicating one cell at a time, time is split into windows of approx_window
+ *  units (at most 100, the minimum time between replications, so no cell replicates twice in a
+ *  window and offspring never replicate in the window they were born).  All replications due in
+ *  a window are resolved together against the state of the multicell at the start of the
+ *  window:
+ *
+ *   1. Every parent picks its target, its offspring's genotype and the next replication times.
+ *      Parents are split into fixed-size batches, each with its own random number generator, so
+ *      batches run on separate threads (domain_threads) with results that do not depend on the
+ *      number of threads.
+ *   2. Births into each cell are replayed in time order (ties go to the lower position): the
+ *      first fills the cell, later unrestrained births overwrite it, and later restrained
+ *      parents look for another empty neighbor once all other births are placed.  Parents that
+ *      are overwritten earlier in the window do not replicate.
+ *   3. The fill time is the time of the birth that filled the last empty cell; overwrites after
+ *      it in the same window are undone.
+ *
+ *  The error comes from parents that would have seen a cell filled (or a different genotype)
+ *  earlier in the same window; it shrinks with the window size.  Use validate_approx (-U) to measure the
+ *  bias against exact runs for a set of treatments before relying on it.
+ */
+
+#ifndef APPROX_ENGINE_H
+#define APPROX_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "emp/base/vector.hpp"
+#include "emp/math/Random.hpp"
+
+#include "Multicell.h"
+#include "PerfCounters.h"
+
+class ApproxEngine {
+private:
+  static constexpr size_t BATCH_SIZE = 4096;   ///< Parents sharing one random number generator.
+  static constexpr size_t NO_TARGET = (size_t) -1;
+
+  /// Everything a parent decides during phase 1 of a window.
+  struct Proposal {
+    double time = 0.0;             ///< When does the parent replicate?
+    size_t parent = 0;             ///< Position of the parent.
+    size_t target = NO_TARGET;     ///< Position of the offspring (NO_TARGET if none).
+    int offspring_ones = 0;        ///< Genotype of the offspring (after mutations).
+    double offspring_time = 0.0;   ///< When will the offspring replicate?
+    double parent_time = 0.0;      ///< When will the parent replicate again? (0.0 if full)
+    bool restrained = false;       ///< Was the parent restrained?
+
+    bool Beats(const Proposal & other) const {
+      return time < other.time || (time == other.time && parent < other.parent);
+    }
+  };
+
+  struct Change {
+    double time;     ///< When was the cell overwritten?
+    size_t pos;      ///< Which cell was it?
+    int old_ones;    ///< What genotype did it have before?
+  };
+
+  Multicell & mc;
+  double window;                          ///< Length of each time window.
+  size_t num_threads;                     ///< Threads to resolve batches on.
+  emp::vector<emp::vector<size_t>> buckets;   ///< Ring of windows, holding cells due in each.
+  size_t cur_window = 0;                  ///< Absolute number of the window being processed.
+  emp::vector<Proposal> proposals;        ///< Replications in the current window.
+  emp::vector<size_t> due_stamp;          ///< Last window (+1) each cell was due to replicate.
+  emp::vector<size_t> target_stamp;       ///< Last pass of FindTargets() to see each cell.
+  emp::vector<size_t> first_birth;        ///< Earliest proposal targeting each cell.
+  emp::vector<size_t> last_birth;         ///< Latest unrestrained one (NO_TARGET if none).
+  size_t num_passes = 0;                  ///< Calls to FindTargets() so far.
+  emp::vector<size_t> retries;            ///< Restrained parents that found their target taken.
+  emp::vector<double> fill_times;         ///< Times of births into empty cells in this window.
+  emp::vector<Change> changes;            ///< Occupied cells overwritten in this window.
+
+  size_t GetWindow(double time) const { return (size_t) (time / window); }
+  emp::vector<size_t> & GetBucket(size_t window_id) { return buckets[window_id % buckets.size()]; }
+
+  /// Random seed for a batch within the current window, mixed from a per-window base seed.
+  static int CalcBatchSeed(uint64_t base_seed, size_t batch_id) {
+    uint64_t x = base_seed + (batch_id + 1) * 0x9e3779b97f4a7c15ULL;   // splitmix64 finalizer.
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (int) (x % 2147483647ULL) + 1;
+  }
+
+  /// Phase 1 for one batch: make every parent's random choices against the window-start state.
+  void ProposeBatch(size_t batch_id, uint64_t base_seed, emp::vector<size_t> & ids,
+                    PerfCounters & perf) {
+    emp::Random rand(CalcBatchSeed(base_seed, batch_id));
+    for (size_t i = 0; i < 4; i++) rand.Get();   // Early values barely depend on the seed.
+
+    const size_t end = std::min(proposals.size(), (batch_id + 1) * BATCH_SIZE);
+    for (size_t i = batch_id * BATCH_SIZE; i < end; i++) {
+      Proposal & proposal = proposals[i];
+      SR_PERF_COUNT(perf, queue_pops);
+      // Restrained cells with a full neighborhood stop replicating (as in DoStep).
+      if (mc.is_full[proposal.parent]) { SR_PERF_COUNT(perf, is_full_hits); continue; }
+
+      const Cell & parent = mc.cells[proposal.parent];
+      proposal.restrained = parent.num_ones >= mc.restrain;
+      size_t next_pos = mc.RandomNeighbor(proposal.parent, rand);
+      if (mc.IsEmpty(next_pos) || parent.num_ones < mc.restrain) {
+        proposal.target = next_pos;
+      }
+      else if (!mc.one_check) {
+        next_pos = mc.EmptyNeighbor(proposal.parent, rand, ids, perf);
+        if (next_pos != (size_t) -1) proposal.target = next_pos;
+        else SR_PERF_COUNT(perf, restrained_failures);
+      }
+      else SR_PERF_COUNT(perf, restrained_failures);
+
+      if (proposal.target != NO_TARGET) {
+        proposal.offspring_ones = mc.Mutate(parent.num_ones, rand);
+        proposal.offspring_time = proposal.time + 100.0 + rand.GetDouble(mc.time_range);
+      }
+      proposal.parent_time = proposal.time + 100.0 + rand.GetDouble(mc.time_range);
+    }
+  }
+
+  /// Phase 1 for the whole window, spreading batches across threads.
+  void ProposeAll() {
+    const uint64_t base_seed = mc.random.GetUInt(2147483647);
+    const size_t num_batches = (proposals.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+    const size_t use_threads = std::min(num_threads, num_batches);
+    if (use_threads <= 1) {
+      for (size_t batch_id = 0; batch_id < num_batches; batch_id++) {
+        ProposeBatch(batch_id, base_seed, mc.neighbor_ids, mc.perf);
+      }
+      return;
+    }
+
+    emp::vector<PerfCounters> thread_perf(use_threads);
+    emp::vector<std::thread> threads;
+    for (size_t thread_id = 0; thread_id < use_threads; thread_id++) {
+      threads.emplace_back([this, thread_id, use_threads, num_batches, base_seed, &thread_perf](){
+        emp::vector<size_t> ids;
+        for (size_t batch_id = thread_id; batch_id < num_batches; batch_id += use_threads) {
+          ProposeBatch(batch_id, base_seed, ids, thread_perf[thread_id]);
+        }
+      });
+    }
+    for (std::thread & thread : threads) thread.join();
+    for (const PerfCounters & perf : thread_perf) mc.perf += perf;
+  }
+
+  /// Collect the cells due in the current window, skipping out-of-date and repeated entries.
+  void CollectWindow() {
+    proposals.resize(0);
+    emp::vector<size_t> & bucket = GetBucket(cur_window);
+    for (size_t pos : bucket) {
+      const double repro_time = mc.cells[pos].repro_time;
+      if (mc.IsEmpty(pos) || GetWindow(repro_time) != cur_window) {
+        SR_PERF_COUNT(mc.perf, stale_pops);
+        continue;
+      }
+      if (due_stamp[pos] == cur_window + 1) continue;   // Queued twice in this window.
+      due_stamp[pos] = cur_window + 1;
+      Proposal proposal;
+      proposal.time = repro_time;
+      proposal.parent = pos;
+      proposals.push_back(proposal);
+    }
+    bucket.resize(0);
+  }
+
+  void Schedule(size_t pos, double repro_time) {
+    mc.cells[pos].repro_time = repro_time;
+    GetBucket(GetWindow(repro_time)).push_back(pos);
+  }
+
+  /// Find the earliest proposal targeting each cell, and the latest unrestrained one.
+  void FindTargets() {
+    num_passes++;
+    for (size_t i = 0; i < proposals.size(); i++) {
+      const Proposal & proposal = proposals[i];
+      const size_t target = proposal.target;
+      if (target == NO_TARGET) continue;
+      if (target_stamp[target] != num_passes) {
+        target_stamp[target] = num_passes;
+        first_birth[target] = i;
+        last_birth[target] = NO_TARGET;
+      }
+      else if (proposal.Beats(proposals[first_birth[target]])) first_birth[target] = i;
+      if (!proposal.restrained &&
+          (last_birth[target] == NO_TARGET || proposals[last_birth[target]].Beats(proposal))) {
+        last_birth[target] = i;
+      }
+    }
+  }
+  bool IsTargeted(size_t pos) const { return target_stamp[pos] == num_passes; }
+
+  /// Which proposal's offspring ends up in a targeted cell?
+  size_t GetWinner(size_t pos) const {
+    return (last_birth[pos] != NO_TARGET) ? last_birth[pos] : first_birth[pos];
+  }
+
+  void PlaceOffspring(const Proposal & proposal, size_t pos) {
+    Cell & offspring = mc.cells[pos];
+    if (mc.IsEmpty(offspring)) {
+      mc.num_cells++;
+      offspring.epoch = mc.epoch;
+    }
+    else changes.push_back(Change{proposal.time, pos, offspring.num_ones});
+    offspring.num_ones = proposal.offspring_ones;
+    Schedule(pos, proposal.offspring_time);
+    mc.is_full[pos] = 0;
+  }
+
+public:
+  ApproxEngine(Multicell & _mc, size_t _num_threads)
+    : mc(_mc), window(_mc.approx_window), num_threads(_num_threads)
+  {
+    emp_assert(window > 0.0 && window <= 100.0, window);
+    buckets.resize((size_t) std::ceil((100.0 + mc.time_range) / window) + 2);
+    due_stamp.resize(mc.GetSize(), 0);
+    target_stamp.resize(mc.GetSize(), 0);
+    first_birth.resize(mc.GetSize(), 0);
+    last_birth.resize(mc.GetSize(), NO_TARGET);
+  }
+
+  /// Run the multicell (already set up, with its starting cells injected) until it is full.
+  RunResults Run() {
+    size_t first_window = (size_t) -1;
+    for (size_t pos = 0; pos < mc.GetSize(); pos++) {
+      if (mc.IsEmpty(pos)) continue;
+      const double repro_time = mc.cells[pos].repro_time;
+      GetBucket(GetWindow(repro_time)).push_back(pos);
+      first_window = std::min(first_window, GetWindow(repro_time));
+    }
+    cur_window = first_window;
+
+    double fill_time = 0.0;
+    while (true) {
+      CollectWindow();
+      ProposeAll();
+
+      // Phase 2: replay births into each cell in time order.  Parents overwritten earlier in
+      // the window are replaced before their turn.  The first birth into an empty cell fills it,
+      // later unrestrained births overwrite it, and later restrained parents find it occupied
+      // and look for another empty neighbor once the window's other births are in place.
+      FindTargets();
+      for (Proposal & proposal : proposals) {
+        if (IsTargeted(proposal.parent) &&
+            proposals[first_birth[proposal.parent]].time < proposal.time) {
+          proposal.target = NO_TARGET;
+          proposal.parent_time = 0.0;   // The offspring replacing it will be scheduled instead.
+        }
+      }
+      FindTargets();
+      fill_times.resize(0);
+      changes.resize(0);
+      retries.resize(0);
+      for (size_t i = 0; i < proposals.size(); i++) {
+        const Proposal & proposal = proposals[i];
+        if (proposal.target == NO_TARGET) continue;
+        const size_t first = first_birth[proposal.target];
+        if (i == first && mc.IsEmpty(proposal.target)) {
+          fill_times.push_back(proposal.time);
+        }
+        else if (i != first && proposal.restrained) {
+          if (mc.one_check) SR_PERF_COUNT(mc.perf, restrained_failures);
+          else retries.push_back(i);
+        }
+      }
+
+      // Phase 3: apply all births, then let restrained parents that lost their target retry.
+      for (const Proposal & proposal : proposals) {
+        if (proposal.parent_time != 0.0) Schedule(proposal.parent, proposal.parent_time);
+      }
+      for (size_t i = 0; i < proposals.size(); i++) {
+        const Proposal & proposal = proposals[i];
+        const size_t target = proposal.target;
+        if (target == NO_TARGET || GetWinner(target) != i) continue;
+        const Proposal & first = proposals[first_birth[target]];
+        // If the first offspring here was overwritten, place it too so it can be restored.
+        if (first.time < proposal.time && mc.IsEmpty(target)) {
+          PlaceOffspring(first, target);
+        }
+        PlaceOffspring(proposal, target);
+      }
+      std::sort(retries.begin(), retries.end(),
+                [this](size_t a, size_t b){ return proposals[a].Beats(proposals[b]); });
+      for (size_t i : retries) {
+        if (mc.num_cells == mc.GetSize()) break;   // Nowhere left to look.
+        const Proposal & proposal = proposals[i];
+        const size_t next_pos = mc.EmptyNeighbor(proposal.parent, mc.random, mc.neighbor_ids, mc.perf);
+        if (next_pos == (size_t) -1) { SR_PERF_COUNT(mc.perf, restrained_failures); continue; }
+        fill_times.push_back(proposal.time);
+        PlaceOffspring(proposal, next_pos);
+      }
+
+      // If the multicell filled, undo anything overwritten after the last cell was filled.
+      if (mc.num_cells == mc.GetSize()) {
+        fill_time = *std::max_element(fill_times.begin(), fill_times.end());
+        std::sort(changes.begin(), changes.end(),
+                  [](const Change & a, const Change & b){ return a.time > b.time; });
+        for (const Change & change : changes) {
+          if (change.time > fill_time) mc.cells[change.pos].num_ones = change.old_ones;
+        }
+        break;
+      }
+
+      // Move on to the next window with anything in it.
+      do {
+        cur_window++;
+        emp_assert(cur_window < first_window + (1ULL << 40), "Multicell ran out of events.");
+      } while (GetBucket(cur_window).empty());
+    }
+
+    emp_assert(mc.num_cells == mc.GetSize(), mc.num_cells);
+    return mc.CalcResults(fill_time);
+  }
+};
+
+inline RunResults Multicell::RunApprox() {
+  const size_t num_threads = domain_threads ? domain_threads : std::thread::hardware_concurrency();
+  return ApproxEngine(*this, std::max<size_t>(num_threads, 1)).Run();
+}
+
+#endif
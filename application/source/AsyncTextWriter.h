@@ -0,0 +1,87 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  AsyncTextWriter.h
+ *  @brief Text output handed off in chunks to a background thread, so slow streams (e.g. on a
+ *         shared filesystem) do not stall the simulation.
+ *  @note Status: BETA
+ *
+ *  Chunks are written (and flushed) in the order they are submitted, to whichever stream each
+ *  names.  Flush() waits until everything submitted so far is out, so output from other code
+ *  can be interleaved in the right order.  Nothing else may write to a stream while it has
+ *  chunks pending, so std::cout (which the rest of the program prints to) is never handed off.
+ */
+
+#ifndef ASYNC_TEXT_WRITER_H
+#define ASYNC_TEXT_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+class AsyncTextWriter {
+private:
+  std::deque<std::pair<std::ostream *, std::string>> pending;   ///< Chunks waiting to be written.
+  bool writing = false;              ///< Is a chunk being written right now?
+  bool closing = false;
+  std::mutex mutex;
+  std::condition_variable cv;        ///< Signals the writer that there is work (or to stop).
+  std::condition_variable done_cv;   ///< Signals Flush() that a chunk is finished.
+  std::thread writer_thread;
+
+  void RunWriter() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this](){ return pending.size() || closing; });
+      if (pending.empty()) break;          // Only reached when closing with nothing left.
+      auto [os, chunk] = std::move(pending.front());
+      pending.pop_front();
+      writing = true;
+      lock.unlock();
+      os->write(chunk.data(), chunk.size());
+      os->flush();
+      lock.lock();
+      writing = false;
+      done_cv.notify_all();
+    }
+  }
+
+public:
+  AsyncTextWriter() : writer_thread([this](){ RunWriter(); }) { }
+  AsyncTextWriter(const AsyncTextWriter &) = delete;
+  ~AsyncTextWriter() { Close(); }
+
+  /// Queue a chunk of text to be written to os.
+  void Write(std::ostream & os, std::string chunk) {
+    if (chunk.empty()) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.emplace_back(&os, std::move(chunk));
+    }
+    cv.notify_one();
+  }
+
+  /// Wait until every chunk submitted so far has been written and flushed.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this](){ return pending.empty() && !writing; });
+  }
+
+  /// Write out everything queued and stop the background thread.
+  void Close() {
+    if (!writer_thread.joinable()) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closing = true;
+    }
+    cv.notify_one();
+    writer_thread.join();
+  }
+};
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  BalancePredictor.h
+ *  @brief Solve for the mutation-selection balance of a population directly, instead of evolving it.
+ *  @note Status: BETA
+ *
+ *  In Population::NextBirth, an organism reproduces after a repro time drawn from its genotype's
+ *  distribution; it and its offspring then both start new repro times, and the offspring replaces
+ *  a random organism.  In a large population, replacement is a death rate d shared by everyone,
+ *  so a repro time T finishes (rather than being cut short) with probability E[exp(-d T)].  Each
+ *  one that finishes starts two more: the parent's, and the offspring's, mutated by the kernel
+ *  of NextBirth.  That makes a linear map from the rates at which each genotype starts repro
+ *  times to the rates they start in return; at balance its largest eigenvalue is exactly 1.
+ *
+ *  The map only links neighboring genotypes, so whether its largest eigenvalue is below 1 can be
+ *  read off the pivots of one tridiagonal elimination; d is found by bisection, and the rates
+ *  by inverse iteration.  An organism spends (1 - E[exp(-d T)]) / d in each repro time it starts,
+ *  which turns the rates into genotype frequencies.
+ *
+ *  This is the infinite-population limit.  A finite population (-p) is narrower than the
+ *  predicted distribution at any one time, but drifts around it; where selection is weak (e.g.
+ *  well above the restraint threshold in infinite genomes) the prediction matches its long-run
+ *  average rather than any single snapshot.
+ */
+
+#ifndef BALANCE_PREDICTOR_H
+#define BALANCE_PREDICTOR_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "emp/base/vector.hpp"
+
+namespace BalancePredictor {
+
+  /// Mutations of offspring, as in Population::NextBirth.
+  struct Kernel {
+    double mut_prob = 0.0;               ///< Chance an offspring mutates.
+    bool is_infinite = false;            ///< Infinite genome (fixed chance of losing a one)?
+    double inf_mut_decrease_prob = 0.5;  ///< Chance a mutation loses a one, in infinite genomes.
+    size_t genome_size = 100;            ///< Bits in a finite genome.
+
+    /// Chance that a mutation of an organism with these ones loses one (rather than gaining one).
+    double CalcDecreaseProb(int num_ones) const {
+      return is_infinite ? inf_mut_decrease_prob : num_ones / (double) genome_size;
+    }
+  };
+
+  /// Chance that a repro time finishes before a death at this rate: the mean of exp(-rate * T).
+  inline double CalcFinishProb(const emp::vector<double> & samples, double death_rate) {
+    double total = 0.0;
+    for (double sample : samples) total += std::exp(-death_rate * sample);
+    return total / samples.size();
+  }
+
+  struct Balance {
+    int min_ones = 0;             ///< Genotype of the first frequency.
+    emp::vector<double> freqs;    ///< Fraction of the population with each number of ones.
+    double death_rate = 0.0;      ///< Replacements per organism per time unit.
+
+    double CalcAveOnes() const {
+      double total = 0.0;
+      for (size_t i = 0; i < freqs.size(); i++) total += freqs[i] * (min_ones + (int) i);
+      return total;
+    }
+
+    double CalcVarOnes() const {
+      const double mean = CalcAveOnes();
+      double total = 0.0;
+      for (size_t i = 0; i < freqs.size(); i++) {
+        const double diff = min_ones + (int) i - mean;
+        total += freqs[i] * diff * diff;
+      }
+      return total;
+    }
+
+    /// Mean repro time across the population (as ave_repro_time in evolution logs).
+    double CalcAveReproTime(const emp::vector<emp::vector<double>> & samples) const {
+      double total = 0.0;
+      for (size_t i = 0; i < freqs.size(); i++) {
+        double sum = 0.0;
+        for (double sample : samples[i]) sum += sample;
+        total += freqs[i] * sum / samples[i].size();
+      }
+      return total;
+    }
+
+    /// Frequency at the ends of the range, where mutations that would leave it are held back.
+    double CalcEdgeFreq() const { return freqs.front() + (freqs.size() > 1 ? freqs.back() : 0.0); }
+  };
+
+  /// The map from repro times started by each genotype to those they lead to, at a death rate:
+  /// starts[j] = lower[j] * starts[j-1] + diag[j] * starts[j] + upper[j] * starts[j+1].
+  struct BirthMap {
+    emp::vector<double> lower, diag, upper;
+
+    BirthMap(const emp::vector<emp::vector<double>> & samples, int min_ones,
+             const Kernel & kernel, double death_rate)
+      : lower(samples.size(), 0.0), diag(samples.size(), 0.0), upper(samples.size(), 0.0)
+    {
+      const size_t num = samples.size();
+      for (size_t k = 0; k < num; k++) {
+        const double finish = CalcFinishProb(samples[k], death_rate);
+        const double down = kernel.mut_prob * kernel.CalcDecreaseProb(min_ones + (int) k);
+        const double up = kernel.mut_prob - down;
+        diag[k] += finish * (2.0 - kernel.mut_prob);     // Parent, plus an unmutated offspring.
+        if (k > 0) upper[k-1] += finish * down;
+        else diag[k] += finish * down;
+        if (k + 1 < num) lower[k+1] += finish * up;
+        else diag[k] += finish * up;
+      }
+    }
+
+    /// Is the largest eigenvalue below 1?  The map is non-negative, so it is exactly when the
+    /// elimination of (I - map) has only positive pivots.
+    bool IsBelowOne() const {
+      double pivot = 1.0;
+      for (size_t j = 0; j < diag.size(); j++) {
+        pivot = (1.0 - diag[j]) - (j ? lower[j] * upper[j-1] / pivot : 0.0);
+        if (pivot <= 0.0) return false;
+      }
+      return true;
+    }
+
+    /// Solve (I - map) x = rhs in place (only stable while IsBelowOne()).
+    void Solve(emp::vector<double> & rhs) const {
+      const size_t num = diag.size();
+      emp::vector<double> pivots(num);
+      for (size_t j = 0; j < num; j++) {
+        pivots[j] = (1.0 - diag[j]) - (j ? lower[j] * upper[j-1] / pivots[j-1] : 0.0);
+        if (j) rhs[j] += lower[j] / pivots[j-1] * rhs[j-1];
+      }
+      for (size_t j = num; j-- > 0; ) {
+        if (j + 1 < num) rhs[j] += upper[j] * rhs[j+1];
+        rhs[j] /= pivots[j];
+      }
+    }
+  };
+
+  /// Balance among genotypes min_ones and up, given samples of each one's repro time (all
+  /// non-empty).  Mutations that would leave the range keep the offspring at its parent's ones.
+  inline Balance Solve(const emp::vector<emp::vector<double>> & samples, int min_ones,
+                       const Kernel & kernel) {
+    const size_t num = samples.size();
+    Balance balance;
+    balance.min_ones = min_ones;
+
+    // At a death rate of zero every repro time finishes and starts two, so the largest
+    // eigenvalue is 2; raise the rate until it is below 1, then bisect.
+    double fastest = samples[0][0];
+    for (const auto & genotype_samples : samples) {
+      for (double sample : genotype_samples) fastest = std::min(fastest, sample);
+    }
+    double low = 0.0, high = 1.0 / fastest;
+    while (!BirthMap(samples, min_ones, kernel, high).IsBelowOne()) { low = high; high *= 2.0; }
+    for (size_t step = 0; step < 200 && high - low > 1e-12 * high; step++) {
+      const double mid = (low + high) / 2.0;
+      if (BirthMap(samples, min_ones, kernel, mid).IsBelowOne()) high = mid;
+      else low = mid;
+    }
+    balance.death_rate = high;
+
+    // Just above the balance rate, (I - map)^-1 is positive and dominated by the eigenvector.
+    const BirthMap birth_map(samples, min_ones, kernel, high);
+    emp::vector<double> starts(num, 1.0 / num);
+    for (size_t step = 0; step < 100; step++) {
+      emp::vector<double> next(starts);
+      birth_map.Solve(next);
+      double total = 0.0;
+      for (double value : next) total += value;
+      double change = 0.0;
+      for (size_t k = 0; k < num; k++) {
+        next[k] /= total;
+        change = std::max(change, std::abs(next[k] - starts[k]));
+      }
+      starts = next;
+      if (change < 1e-14) break;
+    }
+
+    // Organisms spend (1 - finish) / death_rate in each repro time they start.
+    balance.freqs.resize(num);
+    double total = 0.0;
+    for (size_t k = 0; k < num; k++) {
+      balance.freqs[k] = starts[k] * (1.0 - CalcFinishProb(samples[k], high));
+      total += balance.freqs[k];
+    }
+    for (double & freq : balance.freqs) freq /= total;
+    return balance;
+  }
+
+}
+
+#endif
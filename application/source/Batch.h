@@ -0,0 +1,118 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  Batch.h
+ *  @brief Run many jobs in a single process: "SpatialRestraint batch MANIFEST".
+ *  @note Status: BETA
+ *
+ *  A manifest lists one job per line, each holding the options that would follow the
+ *  executable on its own command line (e.g. "-a 50 -c 32 -g 1000 -L lib/ -E out/1.dat -w 7").
+ *  Options are separated by whitespace, with no quoting or variable expansion; blank lines and
+ *  lines starting with '#' are skipped.  A line may end with "> FILE" to send that job's
+ *  standard output (e.g. its -v log) to FILE instead of the batch's, as a shell would.
+ *
+ *  Jobs run in order, each as a fresh Experiment, so every job writes the same output files
+ *  (-M, -E, -C) that it would have on its own; directories for them are created as needed.
+ *  What carries over between jobs is only what is expensive to rebuild: sample libraries
+ *  loaded with -L (see SampleCache) and the storage allocated for the multicell's cells.
+ *  Loaded libraries are kept up to a cap (512 MB unless given, e.g. "batch MANIFEST 2048"),
+ *  past which the least recently used are dropped; count the cap in the batch's memory.
+ *  A job that fails (e.g. with an unknown option) ends the batch.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "emp/base/vector.hpp"
+#include "emp/math/Random.hpp"
+
+#include "SpatialRestraint.h"
+
+/// Read the jobs in a manifest; each is a full argument list, starting with exe_name.
+inline emp::vector<emp::vector<std::string>> LoadManifest(const std::string & filename,
+                                                          const std::string & exe_name) {
+  std::ifstream fp_in(filename);
+  if (!fp_in.is_open()) {
+    std::cerr << "ERROR: Unable to open manifest " << filename << std::endl;
+    exit(1);
+  }
+  emp::vector<emp::vector<std::string>> jobs;
+  std::string line;
+  while (std::getline(fp_in, line)) {
+    std::stringstream ss(line);
+    emp::vector<std::string> args{exe_name};
+    std::string arg;
+    while (ss >> arg) args.push_back(arg);
+    if (args.size() == 1 || args[1][0] == '#') continue;
+    jobs.push_back(args);
+  }
+  return jobs;
+}
+
+/// Handle "SpatialRestraint batch MANIFEST"; returns the exit code.
+inline int RunBatch(const emp::vector<std::string> & args) {
+  if (args.size() != 3 && args.size() != 4) {
+    std::cerr << "Usage: " << args[0] << " batch ManifestFile [SampleCacheMB]" << std::endl;
+    return 1;
+  }
+  emp::vector<emp::vector<std::string>> jobs = LoadManifest(args[2], args[0]);
+
+  const size_t cache_bytes = args.size() == 4 ? (size_t) std::stoul(args[3]) << 20
+                                              : SampleCache::DEFAULT_MAX_BYTES;
+  auto sample_cache = std::make_shared<SampleCache>(cache_bytes);
+  emp::Random spare_random;
+  Multicell spare_cells(spare_random);   // Holds cell storage between jobs.
+  const auto start_time = std::chrono::steady_clock::now();
+
+  for (size_t job_id = 0; job_id < jobs.size(); job_id++) {
+    emp::vector<std::string> & job_args = jobs[job_id];
+    std::cout << "BATCH job " << (job_id + 1) << " of " << jobs.size() << ":";
+    for (size_t i = 1; i < job_args.size(); i++) std::cout << " " << job_args[i];
+    std::cout << std::endl;
+
+    std::ofstream job_out;
+    std::streambuf * batch_out = std::cout.rdbuf();
+    if (job_args.size() > 2 && job_args[job_args.size() - 2] == ">") {
+      const std::filesystem::path path(job_args.back());
+      if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+      job_out.open(path);
+      if (!job_out.is_open()) {
+        std::cerr << "ERROR: Unable to open " << path.string() << " for the output of job "
+                  << (job_id + 1) << std::endl;
+        return 1;
+      }
+      job_args.resize(job_args.size() - 2);
+      std::cout.rdbuf(job_out.rdbuf());
+    }
+    {
+      Experiment experiment(job_args);
+      for (const char * setting : {"multicell_filename", "evolution_filename", "config_filename"}) {
+        const std::filesystem::path path(experiment.config.GetValue<std::string>(setting));
+        if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+      }
+      experiment.sample_cache = sample_cache;
+      experiment.multicell.SwapStorage(spare_cells);
+      experiment.Run();
+      experiment.multicell.SwapStorage(spare_cells);
+    }
+    std::cout.flush();
+    std::cout.rdbuf(batch_out);
+  }
+
+  const double seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  std::cout << "BATCH finished " << jobs.size() << " jobs in " << seconds << " seconds ("
+            << sample_cache->GetSize() << " sample libraries kept, "
+            << (sample_cache->GetNumBytes() >> 20) << " MB)." << std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  ColumnarIO.h
+ *  @brief Buffered binary column files, written on a background thread, and a reader for them.
+ *  @note Status: BETA
+ *
+ *  File layout (all values little-endian):
+ *    char[8]   magic "SRCOL1\0\0"
+ *    uint32    number of columns
+ *    per column:  uint8 type (0 = int64, 1 = float64), uint32 name length, name bytes
+ *    blocks until end of file:
+ *      uint64  number of rows in block
+ *      per column: that many 8-byte values, stored contiguously
+ *
+ *  Readers for R and Python live in experiments/scripts/ (read_columnar.R, read_columnar.py).
+ */
+
+#ifndef COLUMNAR_IO_H
+#define COLUMNAR_IO_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "emp/base/vector.hpp"
+
+namespace columnar {
+  constexpr char MAGIC[8] = {'S','R','C','O','L','1','\0','\0'};
+
+  enum class Type : uint8_t { INT64=0, FLOAT64=1 };
+
+  /// A single column; values are kept as raw 8-byte words so all columns share one layout.
+  struct Column {
+    std::string name;
+    Type type;
+    emp::vector<uint64_t> values;
+
+    void Add(int64_t value) { uint64_t raw; std::memcpy(&raw, &value, 8); values.push_back(raw); }
+    void Add(double value) { uint64_t raw; std::memcpy(&raw, &value, 8); values.push_back(raw); }
+
+    int64_t GetInt(size_t id) const { int64_t out; std::memcpy(&out, &values[id], 8); return out; }
+    double GetDouble(size_t id) const { double out; std::memcpy(&out, &values[id], 8); return out; }
+  };
+}
+
+/// Collects rows into column blocks and hands full blocks to a background thread for writing.
+class ColumnWriter {
+private:
+  using block_t = emp::vector<columnar::Column>;
+
+  std::ofstream file;
+  block_t cur_block;                 ///< Block currently being filled.
+  size_t block_rows;                 ///< How many rows per block before it is written?
+  size_t cur_col = 0;                ///< Which column gets the next value in the current row?
+
+  std::deque<block_t> pending;       ///< Full blocks waiting to be written.
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool closing = false;
+  std::thread writer_thread;
+
+  template <typename T> void WriteRaw(const T & value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void WriteBlock(const block_t & block) {
+    const uint64_t num_rows = block[0].values.size();
+    WriteRaw(num_rows);
+    for (const columnar::Column & col : block) {
+      file.write(reinterpret_cast<const char *>(col.values.data()), num_rows * 8);
+    }
+  }
+
+  void RunWriter() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this](){ return pending.size() || closing; });
+      if (pending.empty()) break;          // Only reached when closing with nothing left.
+      block_t block = std::move(pending.front());
+      pending.pop_front();
+      lock.unlock();
+      WriteBlock(block);
+      lock.lock();
+    }
+    file.flush();
+  }
+
+  /// Hand off the current block (if it has any rows) to be written.
+  void SubmitBlock() {
+    if (cur_block[0].values.empty()) return;
+    block_t next_block = cur_block;
+    for (columnar::Column & col : next_block) col.values.resize(0);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(std::move(cur_block));
+    }
+    cv.notify_one();
+    cur_block = std::move(next_block);
+    for (columnar::Column & col : cur_block) col.values.reserve(block_rows);
+  }
+
+public:
+  ColumnWriter(const std::string & filename,
+               const emp::vector<std::pair<std::string, columnar::Type>> & columns,
+               size_t _block_rows=65536)
+    : file(filename, std::ios::binary), block_rows(_block_rows)
+  {
+    if (!file.is_open()) {
+      std::cerr << "ERROR: Unable to open '" << filename << "' for output." << std::endl;
+      exit(1);
+    }
+    file.write(columnar::MAGIC, 8);
+    WriteRaw((uint32_t) columns.size());
+    for (const auto & [name, type] : columns) {
+      WriteRaw((uint8_t) type);
+      WriteRaw((uint32_t) name.size());
+      file.write(name.data(), name.size());
+      cur_block.push_back(columnar::Column{name, type, {}});
+      cur_block.back().values.reserve(block_rows);
+    }
+    writer_thread = std::thread([this](){ RunWriter(); });
+  }
+  ColumnWriter(const ColumnWriter &) = delete;
+  ~ColumnWriter() { Close(); }
+
+  /// Add the next value in the current row; the value must match the column's type.
+  template <typename T>
+  ColumnWriter & operator<<(T value) {
+    emp_assert(cur_col < cur_block.size());
+    columnar::Column & col = cur_block[cur_col++];
+    if (col.type == columnar::Type::INT64) col.Add((int64_t) value);
+    else col.Add((double) value);
+    return *this;
+  }
+
+  /// Finish the current row; every column must have been given a value.
+  void EndRow() {
+    emp_assert(cur_col == cur_block.size(), cur_col, cur_block.size());
+    cur_col = 0;
+    if (cur_block[0].values.size() >= block_rows) SubmitBlock();
+  }
+
+  /// Write out everything buffered and stop the background thread.
+  void Close() {
+    if (!writer_thread.joinable()) return;
+    SubmitBlock();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closing = true;
+    }
+    cv.notify_one();
+    writer_thread.join();
+    file.close();
+  }
+};
+
+/// Load an entire column file into memory.
+class ColumnReader {
+private:
+  emp::vector<columnar::Column> columns;
+
+public:
+  ColumnReader(const std::string & filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[8];
+    file.read(magic, 8);
+    if (!file || std::memcmp(magic, columnar::MAGIC, 8) != 0) {
+      std::cerr << "ERROR: '" << filename << "' is not a column file." << std::endl;
+      exit(1);
+    }
+    uint32_t num_cols = 0;
+    file.read(reinterpret_cast<char *>(&num_cols), 4);
+    for (uint32_t i = 0; i < num_cols; i++) {
+      uint8_t type;
+      uint32_t name_size;
+      file.read(reinterpret_cast<char *>(&type), 1);
+      file.read(reinterpret_cast<char *>(&name_size), 4);
+      std::string name(name_size, '\0');
+      file.read(name.data(), name_size);
+      columns.push_back(columnar::Column{name, (columnar::Type) type, {}});
+    }
+    uint64_t num_rows;
+    while (file.read(reinterpret_cast<char *>(&num_rows), 8)) {
+      for (columnar::Column & col : columns) {
+        const size_t start = col.values.size();
+        col.values.resize(start + num_rows);
+        file.read(reinterpret_cast<char *>(col.values.data() + start), num_rows * 8);
+      }
+    }
+  }
+
+  size_t GetNumColumns() const { return columns.size(); }
+  size_t GetNumRows() const { return columns.size() ? columns[0].values.size() : 0; }
+  const columnar::Column & GetColumn(size_t id) const { return columns[id]; }
+
+  /// Find a column by name; returns GetNumColumns() if there is no such column.
+  size_t FindColumn(const std::string & name) const {
+    for (size_t i = 0; i < columns.size(); i++) if (columns[i].name == name) return i;
+    return columns.size();
+  }
+};
+
+#endif
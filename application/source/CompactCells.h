@@ -0,0 +1,116 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  CompactCells.h
+ *  @brief Compact cell storage and event queue for very large multicells (-q).
+ *  @note Status: BETA
+ *
+ *  A standard Cell takes 24 bytes, plus a byte in is_full and a 16+ byte queue entry for every
+ *  live cell.  A CompactCell packs everything into 8 bytes: the id is implicit (its position),
+ *  the genotype is stored relative to the restraint threshold, and the replication time is kept
+ *  in fixed point, modulo 2^32 ticks.  Since every pending event falls within 100 + time_range
+ *  of the current time, wrapped times can always be compared against the current time.
+ *
+ *  The CompactQueue is a calendar queue: a ring of buckets, each covering one time unit and
+ *  holding only cell ids (4 bytes per event).  A bucket is sorted by the cells' own times when
+ *  it is reached; entries whose cell has since been rescheduled are dropped at that point.
+ */
+
+#ifndef COMPACT_CELLS_H
+#define COMPACT_CELLS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "emp/base/assert.hpp"
+#include "emp/base/vector.hpp"
+
+/// A single cell packed into 8 bytes.
+struct CompactCell {
+  static constexpr uint8_t OCCUPIED = 1;   ///< Is there a live cell here?
+  static constexpr uint8_t FULL = 2;       ///< Is the local neighborhood full? (restrained only)
+
+  uint32_t repro_tick = 0;   ///< Replication time in CompactQueue ticks, modulo 2^32.
+  int16_t ones_offset = 0;   ///< Number of ones in the genome, minus the restraint threshold.
+  uint8_t flags = 0;         ///< OCCUPIED and/or FULL.
+  uint8_t unused = 0;
+
+  bool IsOccupied() const { return flags & OCCUPIED; }
+  bool IsFull() const { return flags & FULL; }
+};
+
+static_assert(sizeof(CompactCell) == 8, "CompactCell should pack into 8 bytes.");
+
+class CompactQueue {
+public:
+  static constexpr double TICKS_PER_TIME = 65536.0;   ///< Fixed-point resolution of event times.
+
+private:
+  static constexpr uint64_t BUCKET_TICKS = 65536;     ///< Each bucket covers one time unit.
+
+  emp::vector<emp::vector<uint32_t>> buckets;   ///< Ring of future buckets, holding cell ids.
+  emp::vector<std::pair<uint32_t, uint32_t>> ready;  ///< Current bucket as sorted (tick, id).
+  size_t ready_pos = 0;        ///< Next position to pop from ready.
+  uint64_t cur_bucket = 0;     ///< Absolute number of the bucket currently in ready (0 = none yet).
+  uint64_t cur_tick = 0;       ///< Absolute time (in ticks) of the most recent event.
+  size_t num_entries = 0;      ///< Ids waiting in buckets (including out-of-date ones).
+
+public:
+  /// Setup an empty queue for events up to max_wait time units in the future.  Waits must be at
+  /// least one bucket (time unit) long so that new events never land in the bucket currently
+  /// being processed.
+  void Reset(double max_wait) {
+    const size_t num_buckets = (size_t) std::ceil(max_wait * TICKS_PER_TIME / BUCKET_TICKS) + 2;
+    buckets.resize(0);
+    buckets.resize(num_buckets);
+    ready.resize(0);
+    ready_pos = 0;
+    cur_bucket = 0;
+    cur_tick = 0;
+    num_entries = 0;
+  }
+
+  static uint64_t ToTicks(double time) { return (uint64_t) std::llround(time * TICKS_PER_TIME); }
+
+  double GetTime() const { return cur_tick / TICKS_PER_TIME; }
+  uint64_t GetTick() const { return cur_tick; }
+
+  /// Schedule a cell at an absolute time (in ticks); the cell must also record this time.
+  void Insert(uint32_t id, uint64_t tick) {
+    emp_assert(tick / BUCKET_TICKS > cur_bucket, tick, cur_bucket);
+    emp_assert(tick / BUCKET_TICKS < cur_bucket + buckets.size());
+    buckets[(tick / BUCKET_TICKS) % buckets.size()].push_back(id);
+    num_entries++;
+  }
+
+  /// Remove and return the id of the next cell to replicate, advancing the current time.
+  uint32_t Next(const emp::vector<CompactCell> & cells) {
+    while (ready_pos == ready.size()) {
+      emp_assert(num_entries > 0, "CompactQueue is empty");
+      cur_bucket++;
+      ready.resize(0);
+      ready_pos = 0;
+      emp::vector<uint32_t> & bucket = buckets[cur_bucket % buckets.size()];
+      const uint32_t start_tick = (uint32_t) (cur_bucket * BUCKET_TICKS);
+      for (uint32_t id : bucket) {
+        const CompactCell & cell = cells[id];
+        // Keep only cells that are still scheduled in this bucket.
+        if (cell.IsOccupied() && (uint32_t) (cell.repro_tick - start_tick) < BUCKET_TICKS) {
+          ready.emplace_back(cell.repro_tick - start_tick, id);
+        }
+      }
+      num_entries -= bucket.size();
+      bucket.resize(0);
+      std::sort(ready.begin(), ready.end());
+      ready.erase(std::unique(ready.begin(), ready.end()), ready.end());  // Cells queued twice.
+    }
+    const auto [offset, id] = ready[ready_pos++];
+    cur_tick = cur_bucket * BUCKET_TICKS + offset;
+    return id;
+  }
+};
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  CounterRNG.h
+ *  @brief Counter-based random streams, so every replicate's randomness has a fixed address.
+ *  @note Status: BETA
+ *
+ *  Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011) maps
+ *  a 128-bit counter and a 64-bit key to 128 random bits, with no state carried between calls.
+ *  Keying it with the run's random seed and counting with (combo_id, rep_id) gives each
+ *  replicate its own stream, independent of every other replicate: any subset of a sweep of
+ *  multicells can be rerun, in any order, on any machine or number of threads, and reproduce
+ *  the same rows.  Evolution runs also start from their own streams, but by default they share
+ *  a cache of multicell samples that earlier runs of the treatment filled from theirs; a whole
+ *  treatment always reproduces, but a single run only does with independent caches (-i).
+ *
+ *  Simulations still draw from an emp::Random; the counter-based output only seeds it.
+ */
+
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace CounterRNG {
+
+  using Counter = std::array<uint32_t, 4>;
+  using Key = std::array<uint32_t, 2>;
+
+  /// The Philox4x32-10 bijection of ctr under key.
+  inline Counter Philox4x32(Counter ctr, Key key) {
+    constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;    // Round multipliers
+    constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;    // Key schedule (Weyl) increments
+    for (size_t round = 0; round < 10; round++) {
+      if (round) { key[0] += W0; key[1] += W1; }
+      const uint64_t prod0 = (uint64_t) M0 * ctr[0];
+      const uint64_t prod1 = (uint64_t) M1 * ctr[2];
+      ctr = { (uint32_t) (prod1 >> 32) ^ ctr[1] ^ key[0], (uint32_t) prod1,
+              (uint32_t) (prod0 >> 32) ^ ctr[3] ^ key[1], (uint32_t) prod0 };
+    }
+    return ctr;
+  }
+
+  /// Random seed (in [1, 2^31-1], as used by emp::Random) for one stream of one replicate.
+  /// Streams let a replicate have several independent sources of randomness.
+  inline int CalcReplicateSeed(uint64_t base_seed, size_t combo_id, size_t rep_id,
+                               uint32_t stream=0) {
+    const Counter out = Philox4x32({ (uint32_t) rep_id, (uint32_t) ((uint64_t) rep_id >> 32),
+                                     (uint32_t) combo_id, stream },
+                                   { (uint32_t) base_seed, (uint32_t) (base_seed >> 32) });
+    const uint64_t bits = ((uint64_t) out[1] << 32) | out[0];
+    return (int) (bits % 2147483647ULL) + 1;
+  }
+
+}
+
+#endif
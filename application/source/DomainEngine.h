@@ -0,0 +1,330 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  DomainEngine.h
+ *  @brief Exact, spatially parallel simulation of a single multicell (-D).
+ *  @note Status: BETA
+ *
+ *  The grid is split into horizontal strips, one per thread.  Each thread keeps its own event
+ *  queue and random number generator, and applies the same update rules as Multicell::DoStep().
+ *
+ *  Conservative synchronization relies on the lookahead built into the model: a cell always
+ *  waits at least 100 time units between replications, so every event in the window
+ *  [T, T+100) is already scheduled when the window starts.  Threads process each window
+ *  independently, in time order, except near strip edges: an event within two rows of a
+ *  neighboring strip can interact with that strip's edge events, so it waits until the
+ *  neighbor has finished all of its earlier edge events.  Births into another strip's cells are
+ *  passed along at the end of the window (their next events always fall in a later window).
+ *
+ *  Since the multicell may fill part way through a window, every thread records when it filled
+ *  empty cells and which cells it overwrote.  Once the exact fill time is known, overwrites
+ *  after it are undone so the final state matches a serial run stopped at that moment.  Results
+ *  are statistically identical to Multicell::Run(), and deterministic for a given seed and
+ *  number of threads.
+ */
+
+#ifndef DOMAIN_ENGINE_H
+#define DOMAIN_ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+
+#include "emp/base/vector.hpp"
+#include "emp/math/Random.hpp"
+
+#include "Multicell.h"
+#include "PerfCounters.h"
+
+/// Reusable thread barrier; the last thread to arrive runs a completion step (with all other
+/// threads still waiting) before everyone is released.
+class DomainBarrier {
+private:
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t num_threads;
+  size_t num_waiting = 0;
+  size_t generation = 0;
+
+public:
+  DomainBarrier(size_t _num_threads) : num_threads(_num_threads) { }
+
+  template <typename FUN>
+  void Wait(FUN && on_complete) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const size_t cur_generation = generation;
+    if (++num_waiting == num_threads) {
+      on_complete();
+      num_waiting = 0;
+      generation++;
+      cv.notify_all();
+      return;
+    }
+    cv.wait(lock, [this, cur_generation](){ return generation != cur_generation; });
+  }
+  void Wait() { Wait([](){}); }
+};
+
+class DomainEngine {
+private:
+  static constexpr double LOOKAHEAD = 100.0;   ///< Minimum replication time (Multicell::SetupCell)
+  static constexpr double NEVER = std::numeric_limits<double>::infinity();
+
+  using event_t = std::pair<double, size_t>;   ///< (time, cell position)
+
+  struct Change {
+    double time;     ///< When was the cell overwritten?
+    size_t pos;      ///< Which cell was it?
+    int old_ones;    ///< What genotype did it have before?
+  };
+
+  /// All of the state owned by one thread.
+  struct Domain {
+    size_t first_row = 0;            ///< First row in this strip.
+    size_t end_row = 0;              ///< One past the last row in this strip.
+    emp::Random random;
+    emp::vector<size_t> neighbor_ids;   ///< Scratch space for EmptyNeighbor().
+    PerfCounters perf;
+    std::priority_queue<event_t, std::vector<event_t>, std::greater<event_t>> queue;
+
+    emp::vector<event_t> window;        ///< Events in the current window, in time order.
+    emp::vector<double> top_times;      ///< Times of window events near the strip above...
+    emp::vector<double> bottom_times;   ///< ...and near the strip below.
+    std::atomic<double> next_top{NEVER};     ///< Time of next unfinished event near the strip above.
+    std::atomic<double> next_bottom{NEVER};  ///< Time of next unfinished event near the strip below.
+
+    emp::vector<emp::vector<event_t>> outbox;  ///< New events for cells in other strips, by strip.
+    emp::vector<double> fill_times;     ///< When were empty cells filled during this window?
+    emp::vector<Change> changes;        ///< Which occupied cells were overwritten this window?
+  };
+
+  Multicell & mc;
+  emp::vector<std::unique_ptr<Domain>> domains;
+  emp::vector<size_t> row_owner;  ///< Which domain owns each row?
+  DomainBarrier barrier;
+  double window_end = 0.0;      ///< Events before this time are part of the current window.
+  size_t num_filled = 0;        ///< Occupied cells as of the start of the current window.
+  double fill_time = NEVER;     ///< When did the multicell fill? (NEVER until known)
+  bool done = false;
+
+  size_t GetOwner(size_t pos) const { return row_owner[mc.ToY(pos)]; }
+  bool NearTop(size_t d, size_t pos) const {
+    return d > 0 && mc.ToY(pos) < domains[d]->first_row + 2;
+  }
+  bool NearBottom(size_t d, size_t pos) const {
+    return d + 1 < domains.size() && mc.ToY(pos) + 2 >= domains[d]->end_row;
+  }
+
+  /// Give a cell its next replication time and queue it with whichever strip owns it.
+  void Schedule(size_t d, size_t pos, double cur_time) {
+    Domain & dom = *domains[d];
+    const double repro_time = cur_time + 100.0 + dom.random.GetDouble(mc.time_range);
+    mc.cells[pos].repro_time = repro_time;
+    const size_t owner = GetOwner(pos);
+    if (owner == d) dom.queue.emplace(repro_time, pos);
+    else dom.outbox[owner].emplace_back(repro_time, pos);
+  }
+
+  /// Same as Multicell::DoBirth(), but recording what changed.
+  void DoBirth(size_t d, size_t offspring_pos, int parent_ones, double cur_time) {
+    Domain & dom = *domains[d];
+    Cell & offspring = mc.cells[offspring_pos];
+    if (mc.IsEmpty(offspring)) {
+      dom.fill_times.push_back(cur_time);
+      offspring.epoch = mc.epoch;
+    }
+    else dom.changes.push_back(Change{cur_time, offspring_pos, offspring.num_ones});
+    offspring.num_ones = mc.Mutate(parent_ones, dom.random);
+    Schedule(d, offspring_pos, cur_time);
+    mc.is_full[offspring_pos] = 0;
+  }
+
+  /// Same as Multicell::DoStep(), for one event from this strip's window.
+  void DoEvent(size_t d, double cur_time, size_t pos) {
+    Domain & dom = *domains[d];
+    SR_PERF_COUNT(dom.perf, queue_pops);
+    Cell & parent = mc.cells[pos];
+    if (parent.repro_time != cur_time) { SR_PERF_COUNT(dom.perf, stale_pops); return; }
+    if (mc.is_full[pos]) { SR_PERF_COUNT(dom.perf, is_full_hits); return; }
+
+    size_t next_pos = mc.RandomNeighbor(pos, dom.random);
+    if (mc.IsEmpty(next_pos) || parent.num_ones < mc.restrain) {
+      DoBirth(d, next_pos, parent.num_ones, cur_time);
+    }
+    else if (!mc.one_check) {
+      next_pos = mc.EmptyNeighbor(pos, dom.random, dom.neighbor_ids, dom.perf);
+      if (next_pos != (size_t) -1) DoBirth(d, next_pos, parent.num_ones, cur_time);
+      else SR_PERF_COUNT(dom.perf, restrained_failures);
+    }
+    else SR_PERF_COUNT(dom.perf, restrained_failures);
+
+    Schedule(d, pos, cur_time);
+  }
+
+  /// Pull this window's events off of the queue and note which are near other strips.
+  void StartWindow(size_t d) {
+    Domain & dom = *domains[d];
+    dom.window.resize(0);
+    dom.top_times.resize(0);
+    dom.bottom_times.resize(0);
+    while (dom.queue.size() && dom.queue.top().first < window_end) {
+      const event_t event = dom.queue.top();
+      dom.queue.pop();
+      dom.window.push_back(event);
+      if (NearTop(d, event.second)) dom.top_times.push_back(event.first);
+      if (NearBottom(d, event.second)) dom.bottom_times.push_back(event.first);
+    }
+    dom.next_top.store(dom.top_times.size() ? dom.top_times[0] : NEVER, std::memory_order_release);
+    dom.next_bottom.store(dom.bottom_times.size() ? dom.bottom_times[0] : NEVER,
+                          std::memory_order_release);
+  }
+
+  /// Process a window in time order; events near another strip first wait for all of that
+  /// strip's earlier events near this one (ties go to the strip above).
+  void ProcessWindow(size_t d) {
+    Domain & dom = *domains[d];
+    size_t top_id = 0, bottom_id = 0;
+    for (auto [cur_time, pos] : dom.window) {
+      const bool near_top = NearTop(d, pos);
+      const bool near_bottom = NearBottom(d, pos);
+      if (near_top) {
+        const Domain & above = *domains[d-1];
+        while (above.next_bottom.load(std::memory_order_acquire) <= cur_time) std::this_thread::yield();
+      }
+      if (near_bottom) {
+        const Domain & below = *domains[d+1];
+        while (below.next_top.load(std::memory_order_acquire) < cur_time) std::this_thread::yield();
+      }
+
+      DoEvent(d, cur_time, pos);
+
+      if (near_top) {
+        top_id++;
+        dom.next_top.store(top_id < dom.top_times.size() ? dom.top_times[top_id] : NEVER,
+                           std::memory_order_release);
+      }
+      if (near_bottom) {
+        bottom_id++;
+        dom.next_bottom.store(bottom_id < dom.bottom_times.size() ? dom.bottom_times[bottom_id] : NEVER,
+                              std::memory_order_release);
+      }
+    }
+  }
+
+  /// Run with all other threads waiting: check if the multicell filled, then pick the next window.
+  void EndWindow() {
+    size_t num_new = 0;
+    for (auto & dom : domains) num_new += dom->fill_times.size();
+    if (num_filled + num_new >= mc.GetSize()) {
+      emp::vector<double> all_fill_times;
+      for (auto & dom : domains) {
+        all_fill_times.insert(all_fill_times.end(), dom->fill_times.begin(), dom->fill_times.end());
+      }
+      auto last_fill = all_fill_times.begin() + (mc.GetSize() - num_filled - 1);
+      std::nth_element(all_fill_times.begin(), last_fill, all_fill_times.end());
+      fill_time = *last_fill;
+      done = true;
+      return;
+    }
+
+    num_filled += num_new;
+    double next_time = NEVER;
+    for (auto & dom : domains) {
+      dom->fill_times.resize(0);
+      dom->changes.resize(0);
+      if (dom->queue.size()) next_time = std::min(next_time, dom->queue.top().first);
+    }
+    emp_assert(next_time != NEVER, "Multicell ran out of events before filling.");
+    window_end = next_time + LOOKAHEAD;
+  }
+
+  void RunDomain(size_t d) {
+    while (true) {
+      StartWindow(d);
+      barrier.Wait();
+      ProcessWindow(d);
+      barrier.Wait();
+      // Collect events from other strips for cells in this one.
+      for (auto & src : domains) {
+        for (const event_t & event : src->outbox[d]) domains[d]->queue.push(event);
+        src->outbox[d].resize(0);
+      }
+      barrier.Wait([this](){ EndWindow(); });
+      if (done) return;
+    }
+  }
+
+public:
+  DomainEngine(Multicell & _mc, size_t num_domains)
+    : mc(_mc), row_owner(_mc.cells_side), barrier(num_domains)
+  {
+    for (size_t d = 0; d < num_domains; d++) {
+      domains.push_back(std::make_unique<Domain>());
+      Domain & dom = *domains.back();
+      dom.first_row = d * mc.cells_side / num_domains;
+      dom.end_row = (d + 1) * mc.cells_side / num_domains;
+      dom.random.ResetSeed((int) mc.random.GetUInt(2147483647) + 1);
+      // The first few values after a reseed barely depend on the seed (the generator starts
+      // from zero), and each domain's first draws decide its first births; skip past them.
+      for (size_t i = 0; i < 4; i++) dom.random.Get();
+      dom.outbox.resize(num_domains);
+      for (size_t row = dom.first_row; row < dom.end_row; row++) row_owner[row] = d;
+    }
+  }
+
+  /// Run the multicell (already set up, with its starting cells injected) until it is full.
+  RunResults Run() {
+    num_filled = mc.num_cells;
+    double first_time = NEVER;
+    for (size_t pos = 0; pos < mc.GetSize(); pos++) {
+      if (mc.IsEmpty(pos)) continue;
+      const double repro_time = mc.cells[pos].repro_time;
+      domains[GetOwner(pos)]->queue.emplace(repro_time, pos);
+      first_time = std::min(first_time, repro_time);
+    }
+    window_end = first_time + LOOKAHEAD;
+
+    emp::vector<std::thread> threads;
+    for (size_t d = 1; d < domains.size(); d++) threads.emplace_back([this, d](){ RunDomain(d); });
+    RunDomain(0);
+    for (std::thread & thread : threads) thread.join();
+
+    // Undo any overwrites that happened after the multicell filled, latest first.
+    emp::vector<Change> late_changes;
+    for (auto & dom : domains) {
+      for (const Change & change : dom->changes) {
+        if (change.time > fill_time) late_changes.push_back(change);
+      }
+      mc.perf += dom->perf;
+    }
+    std::sort(late_changes.begin(), late_changes.end(),
+              [](const Change & a, const Change & b){ return a.time > b.time; });
+    for (const Change & change : late_changes) mc.cells[change.pos].num_ones = change.old_ones;
+
+    mc.num_cells = mc.GetSize();
+    return mc.CalcResults(fill_time);
+  }
+};
+
+inline RunResults Multicell::RunDomains() {
+  // Each strip needs at least four rows so that only adjacent strips can interact.
+  size_t num_domains = domain_threads ? domain_threads : std::thread::hardware_concurrency();
+  num_domains = std::min(num_domains, cells_side / 4);
+  if (num_domains < 2) {
+    const size_t saved_threads = domain_threads;
+    domain_threads = 1;
+    RunResults results = Run();
+    domain_threads = saved_threads;
+    return results;
+  }
+  return DomainEngine(*this, num_domains).Run();
+}
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  FillTimeEstimator.h
+ *  @brief Estimate fill-time distributions of large multicells from exact runs of small ones.
+ *  @note Status: BETA
+ *
+ *  Sample libraries for large multicells (cells_side 256 or 512) are expensive, but the fill
+ *  time of a genotype changes smoothly with size.  For each genotype, the mean fill time at
+ *  several small sizes is fit with a SizeModel and extrapolated to the full size.  A few anchor
+ *  genotypes are also run exactly at the full size; the ratio of each anchor's mean to its
+ *  extrapolation is a correction, interpolated across the ones axis for every other genotype.
+ *  Standard deviations are too noisy to extrapolate, so the one at the largest small size is
+ *  scaled by a correction from the anchors in the same way.  Samples keep the shape of the
+ *  distribution at the largest small size, rescaled to the estimated mean and deviation.
+ *
+ *  Means are the reliable part (a few percent off); deviations can be off by tens of percent
+ *  for genotypes between anchors, most of all near the restraint threshold.
+ *
+ *  The error of each estimate is reported: for anchors, the standard error of their exact
+ *  mean; for other genotypes, how well each anchor's correction is predicted from the others
+ *  (leave-one-out), which measures how much the correction varies between anchors.
+ */
+
+#ifndef FILL_TIME_ESTIMATOR_H
+#define FILL_TIME_ESTIMATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+
+#include "emp/base/vector.hpp"
+
+namespace FillTimeEstimator {
+
+  /// A statistic as a function of multicell size: y = c0 + c1 * S + c2 * log2(S), where S is
+  /// cells_side.  Filling by restrained growth is close to linear in S (a front crossing the
+  /// multicell); the log term takes up the early, exponential phase.
+  struct SizeModel {
+    double c0 = 0.0, c1 = 0.0, c2 = 0.0;
+
+    double Predict(double side) const { return c0 + c1 * side + c2 * std::log2(side); }
+
+    /// Least-squares fit (just c0 + c1 * S if there are only two sizes).
+    static SizeModel Fit(const emp::vector<double> & sides, const emp::vector<double> & values) {
+      const size_t num_terms = sides.size() >= 3 ? 3 : 2;
+      double m[3][4] = {};   // Normal equations, augmented with the right-hand side.
+      for (size_t i = 0; i < sides.size(); i++) {
+        const double x[3] = { 1.0, sides[i], std::log2(sides[i]) };
+        for (size_t r = 0; r < num_terms; r++) {
+          for (size_t c = 0; c < num_terms; c++) m[r][c] += x[r] * x[c];
+          m[r][3] += x[r] * values[i];
+        }
+      }
+      // Gaussian elimination with partial pivoting.
+      for (size_t col = 0; col < num_terms; col++) {
+        size_t pivot = col;
+        for (size_t r = col + 1; r < num_terms; r++) {
+          if (std::abs(m[r][col]) > std::abs(m[pivot][col])) pivot = r;
+        }
+        for (size_t c = 0; c < 4; c++) std::swap(m[col][c], m[pivot][c]);
+        for (size_t r = col + 1; r < num_terms; r++) {
+          const double factor = m[r][col] / m[col][col];
+          for (size_t c = col; c < 4; c++) m[r][c] -= factor * m[col][c];
+        }
+      }
+      double coeffs[3] = {};
+      for (size_t row = num_terms; row-- > 0; ) {
+        double sum = m[row][3];
+        for (size_t c = row + 1; c < num_terms; c++) sum -= m[row][c] * coeffs[c];
+        coeffs[row] = sum / m[row][row];
+      }
+      return SizeModel{ coeffs[0], coeffs[1], coeffs[2] };
+    }
+  };
+
+  /// Anchor genotypes for a range of ones: both ends, the genotypes on either side of the
+  /// restraint threshold (where fill times change fastest), and the middle of each side.
+  inline emp::vector<int> ChooseAnchors(int min_ones, int max_ones, int restrain) {
+    std::set<int> anchors{ min_ones, max_ones };
+    const int below = std::clamp(restrain - 1, min_ones, max_ones);
+    const int above = std::clamp(restrain, min_ones, max_ones);
+    anchors.insert(below);
+    anchors.insert(above);
+    anchors.insert((min_ones + below) / 2);
+    anchors.insert((above + max_ones) / 2);
+    return emp::vector<int>(anchors.begin(), anchors.end());
+  }
+
+  /// Piecewise-linear interpolation between (num_ones, value) points sorted by num_ones,
+  /// constant beyond the ends.
+  inline double Interpolate(const emp::vector<std::pair<int, double>> & points, int num_ones) {
+    if (num_ones <= points.front().first) return points.front().second;
+    if (num_ones >= points.back().first) return points.back().second;
+    size_t next = 1;
+    while (points[next].first < num_ones) next++;
+    const auto & [x0, y0] = points[next-1];
+    const auto & [x1, y1] = points[next];
+    return y0 + (y1 - y0) * (num_ones - x0) / (double) (x1 - x0);
+  }
+
+  /// Root-mean-square relative error in predicting each point from all of the others.
+  /// Returns -1 if there are too few points to tell.
+  inline double CalcLeaveOneOutError(const emp::vector<std::pair<int, double>> & points) {
+    if (points.size() < 3) return -1.0;
+    double total = 0.0;
+    for (size_t i = 0; i < points.size(); i++) {
+      emp::vector<std::pair<int, double>> others(points);
+      others.erase(others.begin() + i);
+      const double error = Interpolate(others, points[i].first) / points[i].second - 1.0;
+      total += error * error;
+    }
+    return std::sqrt(total / points.size());
+  }
+
+}
+
+#endif
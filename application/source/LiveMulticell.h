@@ -0,0 +1,85 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  LiveMulticell.h
+ *  @brief A multicell that is advanced a time budget at a time and kept drawn in a pixel buffer.
+ *  @note Status: BETA
+ *
+ *  For interactive displays, such as the web app.  Rather than a fixed number of steps per
+ *  frame, Advance() runs steps until a wall-clock budget is used up, so a display stays smooth
+ *  whatever the size of the multicell.  Every placed cell is painted into an RGBA buffer (one
+ *  pixel per cell, row-major), so a whole frame can be shown with a single image upload.
+ *
+ *  Nothing here depends on a browser, so the same code runs in a web worker or headless.
+ */
+
+#ifndef LIVE_MULTICELL_H
+#define LIVE_MULTICELL_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "emp/base/vector.hpp"
+#include "emp/math/Random.hpp"
+
+#include "Multicell.h"
+
+class LiveMulticell {
+private:
+  using clock = std::chrono::steady_clock;
+  static constexpr size_t STEPS_PER_CHECK = 256;   ///< Steps between checks of the clock.
+
+  emp::Random random;
+  Multicell multicell;
+  emp::vector<uint8_t> pixels;   ///< RGBA for each cell, row-major.
+
+public:
+  LiveMulticell(int seed=-1) : random(seed), multicell(random) { }
+
+  Multicell & GetMulticell() { return multicell; }
+  const Multicell & GetMulticell() const { return multicell; }
+  const uint8_t * GetPixels() const { return pixels.data(); }
+  size_t GetNumPixelBytes() const { return pixels.size(); }
+  bool IsDone() const { return multicell.num_cells >= multicell.GetSize(); }
+
+  /// Reseed the random number generator (a seed of zero or less uses the time).
+  void SetSeed(int seed) { random.ResetSeed(seed); }
+
+  /// Repaint the cell at pos into the pixel buffer.
+  void PaintCell(size_t pos) {
+    const size_t pixel_id = multicell.ToY(pos) * multicell.cells_side + multicell.ToX(pos);
+    multicell.GetCellColor(pos, &pixels[pixel_id * 4]);
+  }
+
+  /// Restart from a single cell in the middle, using the multicell's current settings.
+  void Restart(size_t start_1s) {
+    multicell.SetupConfig();
+    pixels.resize(multicell.GetSize() * 4);
+    for (size_t pos = 0; pos < multicell.GetSize(); pos++) PaintCell(pos);
+    multicell.InjectCell(multicell.MiddlePos(), start_1s);
+    PaintCell(multicell.MiddlePos());
+  }
+
+  /// Run steps until budget_ms of wall-clock time has passed or the multicell is full,
+  /// painting every cell that is placed.  Returns the number of steps run.
+  size_t Advance(double budget_ms) {
+    const auto end_time = clock::now() + std::chrono::duration<double, std::milli>(budget_ms);
+    size_t num_steps = 0;
+    while (!IsDone()) {
+      for (size_t i = 0; i < STEPS_PER_CHECK && !IsDone(); i++) {
+        if (!multicell.in_endgame &&
+            multicell.GetSize() - multicell.num_cells <= multicell.endgame_empty) {
+          multicell.StartEndgame();
+        }
+        multicell.DoStep();
+        if (multicell.cell_placed_last_step) PaintCell(multicell.last_placed_cell_id);
+        num_steps++;
+      }
+      if (clock::now() >= end_time) break;
+    }
+    return num_steps;
+  }
+};
+
+#endif
@@ -10,19 +10,26 @@
 #ifndef MULTICELL_H
 #define MULTICELL_H
 
+#include <sstream>
+
 #include "emp/base/vector.hpp"
 #include "emp/base/map.hpp"
+#include "emp/bits/BitVector.hpp"
 #include "emp/math/Random.hpp"
 #include "emp/math/stats.hpp"
 #include "emp/datastructs/TimeQueue.hpp"
 #include "./third_party/gif-h/gif.h"
 
+#include "CompactCells.h"
+#include "PerfCounters.h"
+
 
 /// Information about a single cell.
 struct Cell {
   size_t id;
   double repro_time = 0.0;  ///< When will this cell replicate?
   int num_ones = 0;      ///< How many ones in genome?
+  uint32_t epoch = 0;    ///< Which run placed this cell? (any other than Multicell::epoch is empty)
 
   bool operator==(const Cell & _in) const { return id == _in.id; }
   bool operator!=(const Cell & _in) const { return id != _in.id; }
@@ -38,8 +45,8 @@ struct RunResults {
   emp::map<int, double> cell_counts;  ///< How many cells have each bit count?
   double extra_cost;                  ///< Extra cost due to unrestrained cells.
 
-  RunResults() : run_time(0.0) { ; }
-  RunResults(const size_t num_bits) : run_time(0.0) { ; }
+  RunResults() : run_time(0.0), extra_cost(0.0) { ; }
+  RunResults(const size_t num_bits) : run_time(0.0), extra_cost(0.0) { ; }
   RunResults(const RunResults &) = default;
   RunResults(RunResults &&) = default;
 
@@ -52,7 +59,7 @@ struct RunResults {
       if (emp::Has(cell_counts,key)) cell_counts[key] += value;
       else cell_counts[key] = value;
     }
-    extra_cost += extra_cost;
+    extra_cost += in.extra_cost;
     return *this;
   }
 
@@ -91,13 +98,43 @@ struct RunResults {
   double GetReproTime() const { return run_time + extra_cost; }
 };
 
+/// Which genotypes have identical fill-time distributions, so that their samples can be pooled.
+/// A multicell's behavior depends on its starting genotype only through whether cells are
+/// restrained (num_ones >= restrain) and, with mutations, through where mutations can take
+/// them.  If no lineage can cross the restraint threshold (no mutations, or a finite genome
+/// with the threshold out of reach), all genotypes on the same side of it are equivalent.
+struct SampleClasses {
+  bool can_cross = true;     ///< Can lineages cross the threshold? (If so, nothing is pooled.)
+  int restrain = 0;
+  size_t genome_size = 0;
+  bool is_infinite = false;
+
+  SampleClasses() = default;
+  SampleClasses(double mut_prob, int _restrain, size_t _genome_size, bool _is_infinite)
+    : can_cross(mut_prob > 0.0 && (_is_infinite || (_restrain > 0 && _restrain <= (int) _genome_size)))
+    , restrain(_restrain), genome_size(_genome_size), is_infinite(_is_infinite) { }
+
+  /// The genotype that represents num_ones's class (num_ones itself if it has no equivalents).
+  int Get(int num_ones) const {
+    if (can_cross) return num_ones;
+    if (num_ones < restrain) return is_infinite ? restrain - 1 : std::min(restrain - 1, (int) genome_size);
+    return is_infinite ? restrain : std::max(restrain, 0);
+  }
+
+  bool operator==(const SampleClasses & in) const {
+    return can_cross == in.can_cross && restrain == in.restrain && genome_size == in.genome_size
+      && is_infinite == in.is_infinite;
+  }
+};
+
 /// A single "multicell" organism.
 
 struct Multicell {
   emp::Random & random;
 
   emp::vector<Cell> cells;   ///< All cells in this multicell
-  emp::vector<char> is_full; ///< Is the local neighborhood full?
+  emp::vector<char> is_full; ///< Is the local neighborhood full? (only meaningful if occupied)
+  uint32_t epoch = 0;        ///< Current run; cells tagged with an older epoch are empty.
   size_t num_cells = 0;      ///< How many cells are currnetly in the multicell?
   size_t mask_side = 31;     ///< Bit mask for a side (for id -> x pos)
   size_t log2_side = 5;      ///< Log base 2 of the number of cells on a side (for id -> y pos).
@@ -115,20 +152,103 @@ struct Multicell {
   double unrestrained_cost = 0.0; ///< Extra cost for each unrestrained cell when full.
   double inf_mut_decrease_prob = 0.6; ///< Probability a mutation causes a decrease in ones in inf.
   bool one_check = false;    ///< Should restrained check only one cell to find empty?
+  bool compact = false;      ///< Store cells in 8 bytes each (CompactCells.h) for huge multicells?
+  bool morton = false;       ///< Store cells in Morton (Z-curve) order so neighbors stay nearby?
+  size_t domain_threads = 1; ///< Threads for a single run, on separate strips (DomainEngine.h)
+  double approx_window = 0.0;///< Time window for approximate runs (ApproxEngine.h); 0 = exact.
+  size_t endgame_empty = 0;  ///< Only simulate cells that can matter once this few are empty.
+  bool in_endgame = false;   ///< Has the current run switched to its endgame?
+  bool sub_streams = false;  ///< Draw timing jitter and mutations from their own streams?
+  bool antithetic = false;   ///< Mirror the timing jitter (u -> time_range - u) in this run?
+  emp::Random time_random;   ///< Timing jitter, when using sub-streams.
+  emp::Random mut_random;    ///< Mutations, when using sub-streams.
   size_t last_count = 0;
   size_t last_placed_cell_id = 0;
   bool cell_placed_last_step = false;
+  emp::vector<size_t> neighbor_ids;  ///< Scratch space for EmptyNeighbor (avoids reallocating).
+  PerfCounters perf;                 ///< Event counts and timings for performance reports.
+
+  emp::vector<CompactCell> compact_cells;  ///< Cells, when in compact mode (replaces cells & is_full)
+  CompactQueue compact_queue;              ///< Cells waiting to replicate, when in compact mode.
+
   Multicell(emp::Random & _random) : random(_random), cell_queue(100.0) {
   }
 
+  /// Copy all of the model settings (but not the state) from another multicell.
+  void CopyConfig(const Multicell & in) {
+    time_range = in.time_range;
+    neighbors = in.neighbors;
+    cells_side = in.cells_side;
+    is_infinite = in.is_infinite;
+    genome_size = in.genome_size;
+    restrain = in.restrain;
+    start_1s = in.start_1s;
+    mut_prob = in.mut_prob;
+    unrestrained_cost = in.unrestrained_cost;
+    inf_mut_decrease_prob = in.inf_mut_decrease_prob;
+    one_check = in.one_check;
+    compact = in.compact;
+    morton = in.morton;
+    domain_threads = in.domain_threads;
+    approx_window = in.approx_window;
+    endgame_empty = in.endgame_empty;
+  }
+
+  /// Trade cell storage (but not settings) with another multicell, so allocations made for one
+  /// can be reused by the other; SetupConfig() resets whatever state comes along.
+  void SwapStorage(Multicell & other) {
+    std::swap(cells, other.cells);
+    std::swap(is_full, other.is_full);
+    std::swap(epoch, other.epoch);      // Cell tags are only meaningful with their epoch.
+    std::swap(cell_queue, other.cell_queue);
+    std::swap(compact_cells, other.compact_cells);
+    std::swap(compact_queue, other.compact_queue);
+  }
+
   size_t GetSize() const { return cells_side * cells_side; }
 
-  size_t ToPos(size_t x, size_t y) const { return x + y * cells_side; }
-  size_t ToX(size_t pos) const { return pos & mask_side; }
-  size_t ToY(size_t pos) const { return pos >> log2_side; }
+  /// Spread the low 32 bits of a value out to the even bits (bit i moves to bit 2i).
+  static uint64_t SpreadBits(uint64_t v) {
+    v &= 0xFFFFFFFFULL;
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2))  & 0x3333333333333333ULL;
+    v = (v | (v << 1))  & 0x5555555555555555ULL;
+    return v;
+  }
+
+  /// Inverse of SpreadBits(): gather the even bits of a value back together.
+  static uint64_t CollectBits(uint64_t v) {
+    v &= 0x5555555555555555ULL;
+    v = (v | (v >> 1))  & 0x3333333333333333ULL;
+    v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+    return v;
+  }
+
+  // Positions are row-major by default; with morton, x and y bits are interleaved so that most
+  // neighbors share a cache line (or page).  Always go through these to convert.
+  size_t ToPos(size_t x, size_t y) const {
+    return morton ? SpreadBits(x) | (SpreadBits(y) << 1) : x + y * cells_side;
+  }
+  size_t ToX(size_t pos) const { return morton ? CollectBits(pos) : pos & mask_side; }
+  size_t ToY(size_t pos) const { return morton ? CollectBits(pos >> 1) : pos >> log2_side; }
 
   size_t MiddlePos() const { return ToPos(cells_side/2, cells_side/2); }
 
+  bool IsEmpty(const Cell & cell) const { return cell.epoch != epoch; }
+  bool IsEmpty(size_t pos) const {
+    return compact ? !compact_cells[pos].IsOccupied() : IsEmpty(cells[pos]);
+  }
+  bool IsFull(size_t pos) const { return compact ? compact_cells[pos].IsFull() : is_full[pos]; }
+  void SetFull(size_t pos) {
+    if (compact) compact_cells[pos].flags |= CompactCell::FULL;
+    else is_full[pos] = 1;
+  }
+
 
   std::vector<uint8_t> buffer;
   size_t delay = 1;
@@ -150,10 +270,14 @@ struct Multicell {
   // neighborhood.  (0-5 behaves like a hex-map) Larger assumes popoulation size and returns the
   // full set.
 
-  size_t RandomNeighbor(size_t pos)
+  // The update rules below take the random number generator (and scratch space) to use, so
+  // that the domain-parallel engine (DomainEngine.h) can run them on many threads at once.
+
+  size_t RandomNeighbor(size_t pos) { return RandomNeighbor(pos, random); }
+  size_t RandomNeighbor(size_t pos, emp::Random & rand) const
   {
     if (neighbors == 0 || neighbors > 8) {
-      return random.GetUInt(GetSize());
+      return rand.GetUInt(GetSize());
     }
 
     const size_t x = ToX(pos);
@@ -162,7 +286,7 @@ struct Multicell {
     size_t next_y = (size_t) -1;
 
     while (next_x >= cells_side || next_y >= cells_side) {
-      const size_t dir = random.GetUInt(neighbors);  // Direction for offspring.
+      const size_t dir = rand.GetUInt(neighbors);  // Direction for offspring.
       switch (dir) {
       case 0: case 5: case 7: next_x = x-1; break;
       case 1: case 4: case 6: next_x = x+1; break;
@@ -180,21 +304,9 @@ struct Multicell {
     return ToPos(next_x, next_y);
   }
 
-  size_t EmptyNeighbor(size_t pos)
-  {
-    if (is_full[pos] == 1) return (size_t) -1;
-
-    // If well mixed, keep searching until we find a value.
-    if (neighbors == 0 || neighbors > 8) {
-      size_t id = random.GetUInt(GetSize());
-      while (cells[id].repro_time != 0.0) id = random.GetUInt(GetSize());
-      return id;
-    }
-
-    // Use a static vector so that we don't keep reallocating.
-    static emp::vector<size_t> neighbor_ids;
-    neighbor_ids.resize(0);
-
+  /// Call fun(pos) for each neighbor of pos on the grid (2D neighborhoods only).
+  template <typename FUN>
+  void ForEachNeighbor(size_t pos, FUN && fun) const {
     const size_t x = ToX(pos);
     const size_t y = ToY(pos);
     size_t next_x = (size_t) -1;
@@ -212,83 +324,149 @@ struct Multicell {
       default: next_y = y;
       };
 
-      // If this position is on the grid AND empty
-      if (next_x < cells_side && next_y < cells_side) {
-        const size_t next_pos = ToPos(next_x, next_y);
-        if (cells[next_pos].repro_time == 0.0) neighbor_ids.push_back(next_pos);
+      // Only positions on the grid count.
+      if (next_x < cells_side && next_y < cells_side) fun(ToPos(next_x, next_y));
+    }
+  }
+
+  /// Can a cell at pos still place an offspring in an empty cell?
+  bool HasEmptyNeighbor(size_t pos) const {
+    if (neighbors == 0 || neighbors > 8) return num_cells < GetSize();
+    bool found = false;
+    ForEachNeighbor(pos, [this, &found](size_t next_pos){ if (IsEmpty(next_pos)) found = true; });
+    return found;
+  }
+
+  size_t EmptyNeighbor(size_t pos) { return EmptyNeighbor(pos, random, neighbor_ids, perf); }
+  size_t EmptyNeighbor(size_t pos, emp::Random & rand, emp::vector<size_t> & ids,
+                       [[maybe_unused]] PerfCounters & counters)
+  {
+    SR_PERF_COUNT(counters, empty_neighbor_calls);
+    if (IsFull(pos)) { SR_PERF_COUNT(counters, is_full_hits); return (size_t) -1; }
+
+    // If well mixed, keep searching until we find a value.
+    if (neighbors == 0 || neighbors > 8) {
+      size_t id = rand.GetUInt(GetSize());
+      while (!IsEmpty(id)) {
+        SR_PERF_COUNT(counters, well_mixed_retries);
+        id = rand.GetUInt(GetSize());
       }
+      return id;
     }
 
-    if (neighbor_ids.size() == 0) {
-      is_full[pos] = 1;
+    ids.resize(0);
+    ForEachNeighbor(pos, [this, &ids](size_t next_pos){
+      if (IsEmpty(next_pos)) ids.push_back(next_pos);
+    });
+
+    if (ids.size() == 0) {
+      SetFull(pos);
       return (size_t) -1;
     }
 
-    return neighbor_ids[random.GetUInt(neighbor_ids.size())];
+    return ids[rand.GetUInt(ids.size())];
   }
 
   // Print current one-counts in population.
   void Print() {
     emp_assert(cells.size() == GetSize());
-    size_t pos = 0;
     for (size_t y = 0; y < cells_side; y++) {
       for (size_t x = 0; x < cells_side; x++) {
-        if (cells[pos].repro_time == 0.0) std::cout << " -";
+        const size_t pos = ToPos(x, y);
+        if (IsEmpty(pos)) std::cout << " -";
       	else std::cout << " " << ToChar(cells[pos].num_ones);
-        pos++;
       }
       std::cout << std::endl;
     }
   }
 
+  /// Seed separate streams for neighbor choice (the main generator), timing jitter and
+  /// mutations, so that runs with different settings can still share each kind of draw.
+  void SeedStreams(int neighbor_seed, int time_seed, int mut_seed, bool _antithetic=false) {
+    random.ResetSeed(neighbor_seed);
+    time_random.ResetSeed(time_seed);
+    mut_random.ResetSeed(mut_seed);
+    sub_streams = true;
+    antithetic = _antithetic;
+  }
+
+  /// Random part of a replication time, in [0, time_range).
+  double DrawJitter() {
+    if (!sub_streams) return random.GetDouble(time_range);
+    const double jitter = time_random.GetDouble(time_range);
+    return antithetic ? time_range - jitter : jitter;
+  }
+
   void SetupCell(Cell & cell) {
-    cell.repro_time = cell_queue.GetTime() + 100.0 + random.GetDouble(time_range);
+    cell.repro_time = cell_queue.GetTime() + 100.0 + DrawJitter();
     cell_queue.Insert(cell.id, cell.repro_time);
   }
 
   void InjectCell(size_t pos, int num_ones) {
+    if (compact) {
+      CompactInject(pos, num_ones);
+      return;
+    }
     Cell & inject_cell = cells[pos];                 // Find cell at inject position.
-    if (inject_cell.repro_time == 0.0) num_cells++;  // If cell was empty, mark increase.
+    if (IsEmpty(inject_cell)) {                      // If cell was empty, mark increase.
+      num_cells++;
+      inject_cell.epoch = epoch;
+      is_full[pos] = 0;
+    }
     inject_cell.num_ones = num_ones;                 // Initialize injection ones.
     SetupCell(inject_cell);                          // Do any extra setup for this cell.
   }
 
   void InjectCell(size_t pos) { InjectCell(pos, start_1s); }
 
-  // Setup the new offspring, possibly with mutations.
-  void DoBirth(Cell & offspring, const Cell & parent, bool do_mutations=true) {
-    if (offspring.repro_time == 0.0) num_cells++;  // If offspring was empty, this is a new cell.
-    offspring.num_ones = parent.num_ones;
-    if (do_mutations && random.P(mut_prob)) {
+  /// Classes of genotypes with identical fill-time distributions under these settings.
+  SampleClasses GetSampleClasses() const {
+    return SampleClasses(mut_prob, restrain, genome_size, is_infinite);
+  }
+
+  /// The genotype that represents num_ones's class of equivalent genotypes (see SampleClasses).
+  int GetSampleClass(int num_ones) const { return GetSampleClasses().Get(num_ones); }
+
+  // Determine the number of ones in an offspring, possibly with mutations.
+  int Mutate(int num_ones) { return Mutate(num_ones, sub_streams ? mut_random : random); }
+  int Mutate(int num_ones, emp::Random & rand) const {
+    if (rand.P(mut_prob)) {
       double prob1;
       if (is_infinite) {
           //prob1 = 0.5; // 50/50 chance of adding/removing 1 in infinite genome
           prob1 = inf_mut_decrease_prob; // 50/50 chance of adding/removing 1 in infinite genome
       }
       else {
-          prob1 = ((double) offspring.num_ones) / (double) genome_size; // for set genome length
+          prob1 = ((double) num_ones) / (double) genome_size; // for set genome length
       }
-      if (random.P(prob1)) offspring.num_ones--;
-      else offspring.num_ones++;
+      if (rand.P(prob1)) num_ones--;
+      else num_ones++;
     }
+    return num_ones;
+  }
+
+  // Setup the new offspring, possibly with mutations.
+  void DoBirth(Cell & offspring, const Cell & parent, bool do_mutations=true) {
+    if (IsEmpty(offspring)) {                      // If offspring was empty, this is a new cell.
+      num_cells++;
+      offspring.epoch = epoch;
+    }
+    offspring.num_ones = do_mutations ? Mutate(parent.num_ones) : parent.num_ones;
 
     SetupCell(offspring);       // Launch cell in the population.
     is_full[offspring.id] = 0;  // Mark local region as NOT FULL.
   }
 
   /// Once we have current settings locked in, reset all non-setting values appropriately.
+  /// Cells are not cleared: starting a new epoch leaves every cell from earlier runs empty, so
+  /// a run only pays for the cells it touches.  The grid is rebuilt only when its size changes
+  /// (or the epoch wraps around).
   void SetupConfig() {
-    // Setup initial multicell to be empty; keep count of resources in each cell.
-    cells.resize(0);           // Clear out any current cells.
-    cells.resize(GetSize());   // Put in new cells initialized to 0.
-    for (size_t id = 0; id < cells.size(); id++) {
-      cells[id].id = id;
-      cells[id].repro_time = 0.0;
+    if (compact) {
+      SetupCompact();
+      return;
     }
-    is_full.resize(0);
-    is_full.resize(GetSize(), 0);
-    cell_queue.Reset();
-    num_cells = 0;
+    compact_cells = emp::vector<CompactCell>();   // Release any compact-mode memory.
 
     if (emp::count_bits(cells_side) != 1) {
       std::cerr << "\nERROR: Cannot have " << cells_side << "cells on a side; must be a power of 2!\n";
@@ -296,6 +474,17 @@ struct Multicell {
     }
     mask_side = cells_side - 1;
     log2_side = emp::count_bits(mask_side);
+
+    if (cells.size() != GetSize() || ++epoch == 0) {
+      cells.resize(0);           // Clear out any current cells.
+      cells.resize(GetSize());   // Put in new cells, all in epoch 0.
+      for (size_t id = 0; id < cells.size(); id++) cells[id].id = id;
+      is_full.resize(GetSize());
+      epoch = 1;
+    }
+    cell_queue.Reset();
+    num_cells = 0;
+    in_endgame = false;
   }
 
   // Oversee replication of the next cell in the queue 
@@ -303,22 +492,31 @@ struct Multicell {
       emp_assert(cell_queue.GetSize() > 0);
 
       Cell & parent = cells[cell_queue.Next()];
+      SR_PERF_COUNT(perf, queue_pops);
 
       cell_placed_last_step = false;
       last_placed_cell_id = 0;
 
       // If this cell has been updated since being bufferred, skip it.
-      if (parent.repro_time != cell_queue.GetTime()) return;
+      if (parent.repro_time != cell_queue.GetTime()) { SR_PERF_COUNT(perf, stale_pops); return; }
 
 
       // Neighborhood is only marked full for restrained orgs; if so, fail divide.
-      if (is_full[parent.id]) return;
+      if (is_full[parent.id]) { SR_PERF_COUNT(perf, is_full_hits); return; }
+
+      // In the endgame, restrained cells with no empty neighbors are dropped for good, since
+      // empty cells never reappear (one_check would otherwise keep them replicating).
+      if (in_endgame && parent.num_ones >= restrain && !HasEmptyNeighbor(parent.id)) {
+        SR_PERF_COUNT(perf, endgame_drops);
+        is_full[parent.id] = 1;
+        return;
+      }
 
       size_t next_id = RandomNeighbor(parent.id); // Find the placement of the offspring.
       Cell & next_cell = cells[next_id];
 
       // If the target is empty or we don't restrain, put a new cell there.
-      if (next_cell.repro_time == 0.0 || parent.num_ones < restrain) {
+      if (IsEmpty(next_cell) || parent.num_ones < restrain) {
         DoBirth(next_cell, parent);
         cell_placed_last_step = true;
         last_placed_cell_id = next_id;
@@ -332,7 +530,9 @@ struct Multicell {
           cell_placed_last_step = true;
           last_placed_cell_id = next_id;
         }
+        else SR_PERF_COUNT(perf, restrained_failures);
       }
+      else SR_PERF_COUNT(perf, restrained_failures);
 
       SetupCell(parent);  // Reset parent for its next replication.
 
@@ -348,46 +548,36 @@ struct Multicell {
       }
   }
 
+  /// Write the RGBA color of the cell at pos into rgba: empty cells are black, unrestrained
+  /// cells red (bluer with fewer ones), and restrained cells gray (darker with more ones).
+  void GetCellColor(size_t pos, uint8_t * rgba) const {
+    const Cell & cell = cells[pos];
+    if (IsEmpty(cell)) {
+      rgba[0] = rgba[1] = rgba[2] = 0;
+    }
+    else if (cell.num_ones < restrain) {
+      rgba[0] = (uint8_t) (255 - ((restrain - 1) - cell.num_ones) * 4);
+      rgba[1] = 0;
+      rgba[2] = (uint8_t) (0 + ((restrain - 1) - cell.num_ones) * 2);
+    }
+    else {
+      rgba[0] = rgba[1] = rgba[2] = (uint8_t) (255 - (cell.num_ones - restrain) * 5);
+    }
+    rgba[3] = 255;
+  }
+
   void DrawFrame(GifWriter& gif_writer, size_t pixels_per_cell=1){
-    size_t r = 0;
-    size_t g = 0;
-    size_t b = 0;
-    size_t a = 0;
     size_t width_pixels = cells_side * pixels_per_cell;
-    size_t y_off = 0;
-    size_t x_off = 0;
     size_t width_vals = width_pixels * 4;
+    uint8_t rgba[4];
     for(size_t y = 0; y < cells_side; ++y){
         for(size_t x = 0; x < cells_side; ++x){
-            const Cell& cell_cur = cells[y * cells_side + x];
-            if(cell_cur.repro_time == 0){
-                r = 0;
-                g = 0;
-                b = 0;
-                a = 255;
-            }
-            else if(cell_cur.num_ones < restrain){
-                r = 255 - ((restrain - 1) - cell_cur.num_ones) * 4;
-                g = 0;
-                b = 0 + ((restrain - 1) - cell_cur.num_ones) * 2;
-                a = 255;
-            }
-            else{
-                r = 255 - (cell_cur.num_ones - restrain) * 5;
-                g = 255 - (cell_cur.num_ones - restrain) * 5;
-                b = 255 - (cell_cur.num_ones - restrain) * 5;
-                a = 255;
-            }
-            for(y_off = 0; y_off < pixels_per_cell; ++y_off){
-              for(x_off = 0; x_off < pixels_per_cell; ++x_off){
-                buffer[y * width_vals * pixels_per_cell + y_off * width_vals +
-                  (x * 4 * pixels_per_cell + x_off * 4)]     = r;
-                buffer[y * width_vals * pixels_per_cell + y_off * width_vals +
-                  (x * 4 * pixels_per_cell + x_off * 4) + 1] = g;
-                buffer[y * width_vals * pixels_per_cell + y_off * width_vals +
-                  (x * 4 * pixels_per_cell + x_off * 4) + 2] = b;
-                buffer[y * width_vals * pixels_per_cell + y_off * width_vals +
-                  (x * 4 * pixels_per_cell + x_off * 4) + 3] = a;
+            GetCellColor(ToPos(x, y), rgba);
+            for(size_t y_off = 0; y_off < pixels_per_cell; ++y_off){
+              for(size_t x_off = 0; x_off < pixels_per_cell; ++x_off){
+                uint8_t * pixel = &buffer[y * width_vals * pixels_per_cell + y_off * width_vals +
+                  (x * 4 * pixels_per_cell + x_off * 4)];
+                for (size_t channel = 0; channel < 4; channel++) pixel[channel] = rgba[channel];
               }
             }
         }
@@ -399,6 +589,11 @@ struct Multicell {
 
   /// Run the multicell until it is full.
   RunResults Run(bool print_trace=false, int frames_per_anim = -1, std::ostream & os=std::cout, size_t pixels_per_cell=1) {
+    if (compact) return RunCompact();   // Compact mode does not support traces or animations.
+    if (approx_window > 0.0 && !print_trace && frames_per_anim == -1) return RunApprox();
+    if (domain_threads != 1 && !print_trace && frames_per_anim == -1 && neighbors > 0 && neighbors <= 8) {
+      return RunDomains();
+    }
     last_count = 0;                   // Track cells from last time (for traces)
     // Animation variables
     std::stringstream string_stream;
@@ -411,6 +606,7 @@ struct Multicell {
     }
     size_t cur_step = 0;
     while (num_cells < cells.size()) {
+      if (!in_endgame && cells.size() - num_cells <= endgame_empty) StartEndgame();
       DoStep(print_trace, frames_per_anim, os);
       if(frames_per_anim != -1){
         if(cur_step % frames_per_anim == 0)
@@ -423,9 +619,31 @@ struct Multicell {
       GifEnd(&gif_writer);
     }
 
-    // Setup the results and return them.
+    return CalcResults(cell_queue.GetTime());
+  }
+
+  /// Switch to the endgame once only endgame_empty cells are left empty.  Since a restrained
+  /// cell replicates only into empty cells, and empty cells never reappear, a restrained cell
+  /// with no empty neighbors can never change anything again.  The queue is rebuilt with just
+  /// the cells that can: those next to an empty cell, plus unrestrained cells (which can
+  /// overwrite neighbors).  All remaining events keep their times, so results stay exact.
+  void StartEndgame() {
+    in_endgame = true;
+    emp::vector<std::pair<double, size_t>> events;
+    for (const Cell & cell : cells) {
+      if (IsEmpty(cell) || is_full[cell.id]) continue;   // No live event.
+      if (cell.num_ones >= restrain && !HasEmptyNeighbor(cell.id)) continue;
+      events.emplace_back(cell.repro_time, cell.id);
+    }
+    std::sort(events.begin(), events.end());   // Keep tied events in a deterministic order.
+    cell_queue.Reset();
+    for (auto [time, id] : events) cell_queue.Insert(id, time);
+  }
+
+  /// Summarize the current (full) multicell as the results of a run that took run_time.
+  RunResults CalcResults(double run_time) const {
     RunResults results;
-    results.run_time = cell_queue.GetTime();
+    results.run_time = run_time;
     size_t unrestrained_count = 0;
     for (const auto & cell : cells) {
       if (cell.num_ones < restrain) unrestrained_count++;
@@ -435,6 +653,109 @@ struct Multicell {
     results.extra_cost = unrestrained_count * unrestrained_cost;
     return results;
   }
+
+  /// Run until full with the domain-parallel engine; defined in DomainEngine.h.
+  RunResults RunDomains();
+
+  /// Run until full with the approximate time-window engine; defined in ApproxEngine.h.
+  RunResults RunApprox();
+
+  // ---- Compact mode (see CompactCells.h) ----
+
+  void SetupCompact() {
+    cells = emp::vector<Cell>();                 // Release any standard-mode memory.
+    is_full = emp::vector<char>();
+    epoch = 0;
+    cell_queue.Reset();
+    num_cells = 0;
+    in_endgame = false;
+
+    if (emp::count_bits(cells_side) != 1) {
+      std::cerr << "\nERROR: Cannot have " << cells_side << "cells on a side; must be a power of 2!\n";
+      exit(1);
+    }
+    // Genotypes must fit in 16 bits and all pending events must fall within half of the 2^32
+    // tick range for wrapped times to compare correctly.
+    if (GetSize() > (1ULL << 32) || (!is_infinite && genome_size > 32767) ||
+        std::abs(restrain) > 32767 || time_range + 100.0 >= 32768.0) {
+      std::cerr << "\nERROR: Compact mode requires at most 2^16 cells on a side, genomes and "
+                << "restraint thresholds below 32768, and time_range below 32668.\n";
+      exit(1);
+    }
+    mask_side = cells_side - 1;
+    log2_side = emp::count_bits(mask_side);
+
+    compact_cells.resize(0);
+    compact_cells.resize(GetSize());
+    compact_queue.Reset(100.0 + time_range);
+  }
+
+  int GetCompactOnes(size_t pos) const { return compact_cells[pos].ones_offset + restrain; }
+
+  void SetupCompactCell(size_t pos) {
+    const uint64_t tick =
+      compact_queue.GetTick() + CompactQueue::ToTicks(100.0 + DrawJitter());
+    compact_cells[pos].repro_tick = (uint32_t) tick;
+    compact_queue.Insert((uint32_t) pos, tick);
+  }
+
+  void CompactInject(size_t pos, int num_ones) {
+    CompactCell & cell = compact_cells[pos];
+    if (!cell.IsOccupied()) num_cells++;
+    cell.ones_offset = (int16_t) (num_ones - restrain);
+    cell.flags = CompactCell::OCCUPIED;
+    SetupCompactCell(pos);
+  }
+
+  void CompactBirth(size_t offspring_pos, int parent_ones) {
+    const int num_ones = Mutate(parent_ones);
+    emp_assert(std::abs(num_ones - restrain) <= 32767, num_ones, restrain);
+    CompactInject(offspring_pos, num_ones);    // Also marks local region as NOT FULL.
+  }
+
+  /// Compact-mode version of DoStep(), with the same logic and the same random draws.
+  void DoCompactStep() {
+    const uint32_t parent_pos = compact_queue.Next(compact_cells);
+    SR_PERF_COUNT(perf, queue_pops);
+    const CompactCell & parent = compact_cells[parent_pos];
+
+    if (parent.repro_tick != (uint32_t) compact_queue.GetTick()) { SR_PERF_COUNT(perf, stale_pops); return; }
+    if (parent.IsFull()) { SR_PERF_COUNT(perf, is_full_hits); return; }
+
+    const int parent_ones = GetCompactOnes(parent_pos);
+    size_t next_pos = RandomNeighbor(parent_pos);
+    if (IsEmpty(next_pos) || parent_ones < restrain) CompactBirth(next_pos, parent_ones);
+    else if (!one_check) {
+      next_pos = EmptyNeighbor(parent_pos);
+      if (next_pos != (size_t) -1) CompactBirth(next_pos, parent_ones);
+      else SR_PERF_COUNT(perf, restrained_failures);
+    }
+    else SR_PERF_COUNT(perf, restrained_failures);
+
+    SetupCompactCell(parent_pos);
+  }
+
+  /// Compact-mode version of Run().
+  RunResults RunCompact() {
+    while (num_cells < GetSize()) DoCompactStep();
+
+    RunResults results;
+    results.run_time = compact_queue.GetTime();
+    emp::vector<double> offset_counts(1 << 16, 0.0);   // Count by offset to avoid map lookups.
+    for (const CompactCell & cell : compact_cells) offset_counts[cell.ones_offset + 32768] += 1.0;
+    size_t unrestrained_count = 0;
+    for (int offset = -32768; offset < 32768; offset++) {
+      const double count = offset_counts[offset + 32768];
+      if (count == 0.0) continue;
+      if (offset < 0) unrestrained_count += (size_t) count;
+      results.cell_counts[offset + restrain] = count;
+    }
+    results.extra_cost = unrestrained_count * unrestrained_cost;
+    return results;
+  }
 };
 
+#include "DomainEngine.h"
+#include "ApproxEngine.h"
+
 #endif
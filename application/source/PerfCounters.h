@@ -0,0 +1,109 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  PerfCounters.h
+ *  @brief Hot-path event counters and per-phase wall times for performance reports (-K).
+ *  @note Status: BETA
+ *
+ *  Event counters sit in the innermost simulation loops, so they are only compiled in when
+ *  SR_PERF_COUNTERS is defined ("make perf"); otherwise SR_PERF_COUNT() expands to nothing.
+ *  Phase wall times are cheap (a few clock reads per treatment) and are always tracked.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#ifdef SR_PERF_COUNTERS
+#define SR_PERF_COUNT(COUNTERS, NAME) (++(COUNTERS).NAME)
+#else
+#define SR_PERF_COUNT(COUNTERS, NAME) ((void) 0)
+#endif
+
+struct PerfCounters {
+#ifdef SR_PERF_COUNTERS
+  static constexpr bool ENABLED = true;
+#else
+  static constexpr bool ENABLED = false;
+#endif
+
+  // Multicell events
+  uint64_t queue_pops = 0;           ///< Cells pulled from the multicell event queue.
+  uint64_t stale_pops = 0;           ///< ...that were out of date and skipped.
+  uint64_t is_full_hits = 0;         ///< Replications skipped because the neighborhood was full.
+  uint64_t restrained_failures = 0;  ///< Restrained cells that failed to place an offspring.
+  uint64_t empty_neighbor_calls = 0; ///< Calls to EmptyNeighbor().
+  uint64_t well_mixed_retries = 0;   ///< Extra draws while searching for an empty cell when well mixed.
+  uint64_t endgame_drops = 0;        ///< Restrained cells dropped in the endgame (-G).
+
+  // Population events
+  uint64_t cache_hits = 0;           ///< Reproduction times drawn from the sample cache.
+  uint64_t cache_misses = 0;         ///< Draws that needed a new sample.
+  uint64_t store_hits = 0;           ///< ...that were filled from the result store (-R).
+  uint64_t inline_sims = 0;          ///< ...that required simulating a new multicell.
+
+  // Wall time (in seconds) for each phase of a treatment.
+  double setup_time = 0.0;           ///< Loading samples or stored results.
+  double run_time = 0.0;             ///< Simulating (summed across workers when threaded).
+  double inline_sim_time = 0.0;      ///< Part of run_time spent on inline multicell simulations.
+  double output_time = 0.0;          ///< Writing results.
+
+  PerfCounters & operator+=(const PerfCounters & in) {
+    queue_pops += in.queue_pops;
+    stale_pops += in.stale_pops;
+    is_full_hits += in.is_full_hits;
+    restrained_failures += in.restrained_failures;
+    empty_neighbor_calls += in.empty_neighbor_calls;
+    well_mixed_retries += in.well_mixed_retries;
+    endgame_drops += in.endgame_drops;
+    cache_hits += in.cache_hits;
+    cache_misses += in.cache_misses;
+    store_hits += in.store_hits;
+    inline_sims += in.inline_sims;
+    setup_time += in.setup_time;
+    run_time += in.run_time;
+    inline_sim_time += in.inline_sim_time;
+    output_time += in.output_time;
+    return *this;
+  }
+
+  /// Column names, matching the order of PrintRow().
+  static std::string GetHeaders() {
+    std::string out = "setup_time, run_time, inline_sim_time, output_time";
+    if (ENABLED) {
+      out += ", queue_pops, stale_pops, is_full_hits, restrained_failures, empty_neighbor_calls"
+             ", well_mixed_retries, endgame_drops, cache_hits, cache_misses, store_hits, inline_sims";
+    }
+    return out;
+  }
+
+  void PrintRow(std::ostream & os) const {
+    os << setup_time << ", " << run_time << ", " << inline_sim_time << ", " << output_time;
+    if (ENABLED) {
+      os << ", " << queue_pops << ", " << stale_pops << ", " << is_full_hits
+         << ", " << restrained_failures << ", " << empty_neighbor_calls
+         << ", " << well_mixed_retries << ", " << endgame_drops << ", " << cache_hits
+         << ", " << cache_misses << ", " << store_hits << ", " << inline_sims;
+    }
+  }
+};
+
+/// Add the wall time of a scope to a running total.
+class PerfTimer {
+private:
+  double & total;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  PerfTimer(double & _total) : total(_total), start(std::chrono::steady_clock::now()) { }
+  ~PerfTimer() {
+    total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  ResultStore.h
+ *  @brief Persistent, content-addressed storage of multicell results.
+ *  @note Status: BETA
+ *
+ *  Every multicell replicate is fully determined (up to randomness) by a handful of Multicell
+ *  settings plus the number of ones in the injected cell.  The ResultStore hashes those values
+ *  into a key and keeps one append-only file per key in a directory on disk, so any run can
+ *  reuse samples produced by earlier runs and only simulate what is still missing.
+ *
+ *  File format: the first line is "# " followed by the full (unhashed) key, used to detect hash
+ *  collisions.  Each following line is one replicate:
+ *    run_time extra_cost ones:count ones:count ...
+ */
+
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "emp/base/vector.hpp"
+#include "emp/base/unordered_map.hpp"
+
+#include "Multicell.h"
+
+class ResultStore {
+private:
+  std::string directory;   ///< Where are result files stored?  Empty means inactive.
+
+  /// All results loaded (or added) so far, indexed by full key.
+  emp::unordered_map<std::string, emp::vector<RunResults>> results_map;
+
+  std::string GetFilename(const std::string & key) const {
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << HashKey(key);
+    return (std::filesystem::path(directory) / (ss.str() + ".dat")).string();
+  }
+
+  /// Load all results stored for a key (if we haven't already).
+  emp::vector<RunResults> & LoadResults(const std::string & key) {
+    auto it = results_map.find(key);
+    if (it != results_map.end()) return it->second;
+
+    emp::vector<RunResults> & results = results_map[key];
+    std::ifstream fp_in(GetFilename(key));
+    if (!fp_in.is_open()) return results;
+
+    std::string line;
+    std::getline(fp_in, line);
+    if (line != "# " + key) {
+      std::cerr << "ERROR: Result store file " << GetFilename(key) << " does not match key:\n"
+                << "  expected: " << key << "\n  found:    " << line.substr(2) << std::endl;
+      exit(1);
+    }
+    while (std::getline(fp_in, line)) {
+      if (line.size()) results.push_back(FromLine(line));
+    }
+    return results;
+  }
+
+public:
+  ResultStore(const std::string & _dir="") { SetDirectory(_dir); }
+
+  /// Hash a key (FNV-1a, 64 bit) to get its filename.
+  static uint64_t HashKey(const std::string & key) {
+    uint64_t hash = 14695981039346656037ULL;        // FNV-1a, 64 bit.
+    for (unsigned char c : key) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  /// Convert a single result to a line of text (without a newline), losing no precision.
+  static std::string ToLine(const RunResults & results) {
+    std::stringstream ss;
+    ss << std::setprecision(std::numeric_limits<double>::max_digits10)
+       << results.run_time << " " << results.extra_cost;
+    for (auto [key,value] : results.cell_counts) ss << " " << key << ":" << value;
+    return ss.str();
+  }
+
+  /// Convert a line of text produced by ToLine() back into a result.
+  static RunResults FromLine(const std::string & line) {
+    RunResults results;
+    std::stringstream ss(line);
+    ss >> results.run_time >> results.extra_cost;
+    std::string entry;
+    while (ss >> entry) {
+      const size_t split = entry.find(':');
+      results.cell_counts[std::stoi(entry.substr(0, split))] = std::stod(entry.substr(split+1));
+    }
+    return results;
+  }
+
+  void SetDirectory(const std::string & _dir) {
+    directory = _dir;
+    results_map.clear();
+    if (directory.size()) std::filesystem::create_directories(directory);
+  }
+
+  bool IsActive() const { return directory.size(); }
+
+  /// Build the full key for a multicell configuration with a given number of ones.
+  static std::string CalcKey(const Multicell & mc, int num_ones) {
+    std::stringstream ss;
+    ss << std::setprecision(std::numeric_limits<double>::max_digits10)
+       << "cells_side=" << mc.cells_side
+       << " neighbors=" << mc.neighbors
+       << " restrain=" << mc.restrain
+       << " genome_size=" << mc.genome_size
+       << " mut_prob=" << mc.mut_prob
+       << " time_range=" << mc.time_range
+       << " one_check=" << mc.one_check
+       << " is_infinite=" << mc.is_infinite
+       << " unrestrained_cost=" << mc.unrestrained_cost
+       << " inf_mut_decrease_prob=" << mc.inf_mut_decrease_prob;
+    if (mc.compact) ss << " compact=1";   // Only listed when used, so older keys stay valid.
+    if (mc.approx_window > 0.0) ss << " approx_window=" << mc.approx_window;
+    ss << " num_ones=" << num_ones;
+    return ss.str();
+  }
+
+  /// How many results are stored for this configuration?
+  size_t CountResults(const Multicell & mc, int num_ones) {
+    if (!IsActive()) return 0;
+    return LoadResults(CalcKey(mc, num_ones)).size();
+  }
+
+  /// Retrieve a specific stored result; must be less than CountResults().
+  const RunResults & GetResult(const Multicell & mc, int num_ones, size_t id) {
+    emp::vector<RunResults> & results = LoadResults(CalcKey(mc, num_ones));
+    emp_assert(id < results.size(), id, results.size());
+    return results[id];
+  }
+
+  /// Record a new result, both in memory and on disk.
+  void AddResult(const Multicell & mc, int num_ones, const RunResults & in_results) {
+    if (!IsActive()) return;
+    const std::string key = CalcKey(mc, num_ones);
+    emp::vector<RunResults> & results = LoadResults(key);
+    const std::string filename = GetFilename(key);
+    const bool is_new = !std::filesystem::exists(filename);
+    std::ofstream fp_out(filename, std::ios::app);
+    if (is_new) fp_out << "# " << key << "\n";
+    fp_out << ToLine(in_results) << std::endl;
+    results.push_back(in_results);
+  }
+};
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  SampleLibrary.h
+ *  @brief Layout of on-disk libraries of multicell reproduction-time samples.
+ *  @note Status: BETA
+ *
+ *  Libraries are organized as the experiment scripts expect (and as -L loads them):
+ *    ROOT/thresh__RESTRAIN/cell_mut__MUT_PROB/mcsize__CELLS_SIDE/NUM_ONES.dat
+ *  where each .dat file holds one reproduction time per line.  Each treatment directory also
+ *  holds a settings.txt describing every setting used to produce its samples so that libraries
+ *  built under different settings are never mixed.  Libraries whose genotypes were given
+ *  different numbers of samples (see AdaptiveSampling.h) also hold a sample_counts.txt, with a
+ *  "NUM_ONES COUNT" line for each genotype; loading honors those counts.
+ *
+ *  A SampleCache keeps libraries that have already been loaded with -L, so that other
+ *  treatments (or other jobs in a batch; see Batch.h) that load the same files skip the disk.
+ *  Its samples are capped in size; past the cap, the least recently used libraries are dropped
+ *  (and reloaded from disk if they are needed again).
+ */
+
+#ifndef SAMPLE_LIBRARY_H
+#define SAMPLE_LIBRARY_H
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "emp/base/unordered_map.hpp"
+#include "emp/base/vector.hpp"
+
+#include "Multicell.h"
+#include "ResultStore.h"
+
+struct SampleLibrary {
+  /// Format a mutation probability the way the experiment scripts do (e.g., 0.2, 0.05, 1.0).
+  static std::string FormatMutProb(double mut_prob) {
+    std::stringstream ss;
+    ss << mut_prob;
+    std::string out = ss.str();
+    if (out.find_first_of(".e") == std::string::npos) out += ".0";
+    return out;
+  }
+
+  /// Directory (with trailing slash) holding the samples for a multicell's settings.
+  static std::string GetTreatmentDir(const std::string & root, const Multicell & mc) {
+    std::filesystem::path path(root);
+    path /= "thresh__" + std::to_string(mc.restrain);
+    path /= "cell_mut__" + FormatMutProb(mc.mut_prob);
+    path /= "mcsize__" + std::to_string(mc.cells_side);
+    return path.string() + "/";
+  }
+
+  static std::string GetSampleFilename(const std::string & treatment_dir, int num_ones) {
+    return treatment_dir + std::to_string(num_ones) + ".dat";
+  }
+
+  /// Description of all settings a treatment directory's samples depend on.
+  static std::string GetSettingsString(const Multicell & mc) {
+    std::string key = ResultStore::CalcKey(mc, 0);
+    return key.substr(0, key.rfind(" num_ones="));
+  }
+
+  /// Make sure a treatment directory exists and was built with the same settings (plus a
+  /// note on how its samples were made, if they were not simulated directly).
+  static void PrepareTreatmentDir(const std::string & treatment_dir, const Multicell & mc,
+                                  const std::string & note="") {
+    std::filesystem::create_directories(treatment_dir);
+    const std::string settings_file = treatment_dir + "settings.txt";
+    const std::string settings = GetSettingsString(mc) + note;
+    std::ifstream fp_in(settings_file);
+    if (fp_in.is_open()) {
+      std::string line;
+      std::getline(fp_in, line);
+      if (line != settings) {
+        std::cerr << "ERROR: Samples in " << treatment_dir << " were built with different settings:\n"
+                  << "  existing:  " << line << "\n  requested: " << settings << std::endl;
+        exit(1);
+      }
+      return;
+    }
+    std::ofstream(settings_file) << settings << std::endl;
+  }
+
+  /// Classes of genotypes pooled by a treatment directory's samples, from its settings.txt.
+  /// They depend on the settings the library was built with (e.g. its cell mutation rate),
+  /// which need not match the run loading it; without a settings.txt nothing is pooled.
+  static SampleClasses LoadSampleClasses(const std::string & treatment_dir) {
+    std::ifstream fp_in(treatment_dir + "settings.txt");
+    std::map<std::string, std::string> settings;
+    std::string entry;
+    while (fp_in >> entry) {
+      const size_t split = entry.find('=');
+      if (split != std::string::npos) settings[entry.substr(0, split)] = entry.substr(split + 1);
+    }
+    for (const char * name : {"mut_prob", "restrain", "genome_size", "is_infinite"}) {
+      if (!settings.count(name)) return SampleClasses();
+    }
+    return SampleClasses(std::stod(settings["mut_prob"]), std::stoi(settings["restrain"]),
+                         std::stoul(settings["genome_size"]), settings["is_infinite"] == "1");
+  }
+
+  /// Random seed for a single sample.  It depends only on the base seed, the genotype (with all
+  /// of its settings) and the sample's index, so samples do not change when a library is
+  /// extended with more samples, more genotypes, or more treatments.
+  static int CalcSampleSeed(uint64_t base_seed, const Multicell & mc, size_t sample_id) {
+    uint64_t x = base_seed ^ ResultStore::HashKey(ResultStore::CalcKey(mc, mc.start_1s));
+    x += (sample_id + 1) * 0x9e3779b97f4a7c15ULL;           // splitmix64 finalizer.
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (int) (x % 2147483647ULL) + 1;
+  }
+
+  static std::string GetCountsFilename(const std::string & treatment_dir) {
+    return treatment_dir + "sample_counts.txt";
+  }
+
+  /// Per-genotype sample counts recorded for a treatment directory (empty if there are none).
+  static std::map<int, size_t> LoadSampleCounts(const std::string & treatment_dir) {
+    std::map<int, size_t> counts;
+    std::ifstream fp_in(GetCountsFilename(treatment_dir));
+    int num_ones;
+    size_t count;
+    while (fp_in >> num_ones >> count) counts[num_ones] = count;
+    return counts;
+  }
+
+  static void SaveSampleCounts(const std::string & treatment_dir, const std::map<int, size_t> & counts) {
+    std::ofstream fp_out(GetCountsFilename(treatment_dir));
+    for (auto [num_ones, count] : counts) fp_out << num_ones << " " << count << "\n";
+  }
+
+  /// How many samples are already in a sample file? (0 if it does not exist)
+  static size_t CountSamples(const std::string & filename) {
+    std::ifstream fp_in(filename);
+    size_t count = 0;
+    std::string line;
+    while (std::getline(fp_in, line)) if (line.size()) count++;
+    return count;
+  }
+
+  /// Load up to max_count samples from a sample file (fewer if it is shorter or missing).
+  static emp::vector<double> LoadSamples(const std::string & filename, size_t max_count) {
+    std::ifstream fp_in(filename);
+    emp::vector<double> samples;
+    double sample;
+    while (samples.size() < max_count && fp_in >> sample) samples.push_back(sample);
+    return samples;
+  }
+
+  /// Add new samples to the end of a sample file (or replace its contents), at full precision.
+  static void AppendSamples(const std::string & filename, const emp::vector<double> & samples,
+                            bool replace=false) {
+    std::ofstream fp_out(filename, replace ? std::ios::trunc : std::ios::app);
+    fp_out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (double sample : samples) fp_out << sample << "\n";
+  }
+};
+
+/// Sample libraries already loaded from disk, as they were after loading.
+class SampleCache {
+public:
+  struct Entry {
+    emp::unordered_map<int, emp::vector<double>> repro_cache;   ///< Samples for each class
+    int repro_cache_min = 0;
+    int repro_cache_max = 0;
+    emp::unordered_map<int, size_t> sample_counts;               ///< Per-class counts, if recorded
+    SampleClasses sample_classes;                                ///< How the library pools genotypes
+  };
+
+  static constexpr size_t DEFAULT_MAX_BYTES = (size_t) 512 << 20;
+
+private:
+  struct Slot {
+    Entry entry;
+    size_t num_bytes = 0;                            ///< Size of the entry's samples.
+    std::list<std::string>::iterator recent_pos;     ///< Position in recent.
+  };
+  std::map<std::string, Slot> entries;
+  std::list<std::string> recent;    ///< Keys, most recently used first.
+  size_t max_bytes;                 ///< Cap on the samples kept (the newest entry is always kept).
+  size_t num_bytes = 0;             ///< Samples kept now.
+
+  static size_t CountBytes(const Entry & entry) {
+    size_t total = 0;
+    for (const auto & [num_ones, samples] : entry.repro_cache) total += samples.size() * sizeof(double);
+    return total;
+  }
+
+public:
+  SampleCache(size_t _max_bytes=DEFAULT_MAX_BYTES) : max_bytes(_max_bytes) { }
+
+  /// Everything that determines what loading would produce: the files, the range of ones
+  /// loaded, and how many samples are kept (the files' own settings decide the pooling).
+  static std::string CalcKey(const std::string & directory, int min_ones, int max_ones,
+                             size_t num_samples) {
+    std::stringstream key;
+    key << directory << " ones=" << min_ones << ".." << max_ones << " samples=" << num_samples;
+    return key.str();
+  }
+
+  /// Find a previously loaded library (nullptr if there is none), marking it as recently used.
+  const Entry * Find(const std::string & key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) return nullptr;
+    recent.splice(recent.begin(), recent, it->second.recent_pos);
+    return &it->second.entry;
+  }
+
+  /// Keep a library, dropping the least recently used others while over the size cap.
+  void Add(const std::string & key, Entry entry) {
+    Remove(key);
+    const size_t entry_bytes = CountBytes(entry);
+    recent.push_front(key);
+    entries[key] = Slot{ std::move(entry), entry_bytes, recent.begin() };
+    num_bytes += entry_bytes;
+    while (num_bytes > max_bytes && recent.size() > 1) Remove(recent.back());
+  }
+
+  void Remove(const std::string & key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) return;
+    num_bytes -= it->second.num_bytes;
+    recent.erase(it->second.recent_pos);
+    entries.erase(it);
+  }
+
+  /// Forget everything, e.g. after sample files may have changed on disk.
+  void Clear() { entries.clear(); recent.clear(); num_bytes = 0; }
+
+  size_t GetSize() const { return entries.size(); }
+  size_t GetNumBytes() const { return num_bytes; }
+};
+
+#endif
@@ -0,0 +1,245 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  Shards.h
+ *  @brief Split a sweep across processes (--shard i/N) and merge the pieces back together.
+ *  @note Status: BETA
+ *
+ *  Multicell sweeps are split by replicate: every (treatment, replicate) pair gets a unit id in
+ *  treatment order, and shard i runs the units where (unit_id % N == i).  Evolution sweeps are
+ *  split by treatment, since runs within a treatment share a sample cache.
+ *
+ *  Shard outputs are not final data files; "SpatialRestraint merge OUTFILE SHARDFILES..." turns a
+ *  complete set of them into the multicell.dat or evolution.dat that an unsharded run would produce.
+ *
+ *  Multicell shard format:
+ *    #shard i/N multicell
+ *    #print_reps 0|1
+ *    #header <column header line for multicell.dat>
+ *    #combo <combo_id> <num_runs> <restrain> <cells> <setting values>   (one per treatment)
+ *    <combo_id> <rep_id> <result, as ResultStore::ToLine()>             (one per replicate)
+ *
+ *  Evolution shard format:
+ *    #shard i/N evolution
+ *    #treatments <total number of treatments>
+ *    #treatment <combo_id>       (followed by the evolution.dat rows for that treatment)
+ */
+
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "emp/base/vector.hpp"
+#include "emp/base/map.hpp"
+
+#include "Multicell.h"
+#include "ResultStore.h"
+
+/// Which piece of a sweep should this process run?
+struct ShardInfo {
+  size_t id = 0;         ///< Which shard is this?
+  size_t count = 1;      ///< How many shards in total?
+  bool active = false;   ///< Was sharding requested at all?
+
+  /// Parse a shard description of the form "i/N" (with 0 <= i < N); empty means no sharding.
+  static ShardInfo FromString(const std::string & in) {
+    ShardInfo info;
+    if (in.size() == 0) return info;
+    const size_t split = in.find('/');
+    if (split != std::string::npos) {
+      info.id = std::stoul(in.substr(0, split));
+      info.count = std::stoul(in.substr(split+1));
+    }
+    if (split == std::string::npos || info.count == 0 || info.id >= info.count) {
+      std::cerr << "ERROR: Invalid shard '" << in << "'; expected i/N with 0 <= i < N." << std::endl;
+      exit(1);
+    }
+    info.active = true;
+    return info;
+  }
+
+  /// Does this shard own the unit with the provided id?
+  bool Has(size_t unit_id) const { return unit_id % count == id; }
+
+  std::string ToString() const { return std::to_string(id) + "/" + std::to_string(count); }
+};
+
+/// Output the summary of all replicates of a single multicell treatment.
+inline void PrintTreatmentRow(std::ostream & os, const std::string & combo_string,
+                              const emp::vector<RunResults> & treatment_results, int restrain,
+                              size_t mc_size, bool print_reps) {
+  os << combo_string;
+  RunResults total_results(0);
+  for (const RunResults & results : treatment_results) {
+    if (print_reps) os << ", " << results.GetReproTime();
+    total_results += results;
+  }
+  total_results /= (double) treatment_results.size();
+  os << ", " << total_results.GetReproTime()
+     << ", " << (total_results.CountRestrained(restrain) / (double) mc_size)
+     << std::endl;
+}
+
+namespace internal {
+  [[noreturn]] inline void ShardError(const std::string & filename, const std::string & msg) {
+    std::cerr << "ERROR: While merging " << filename << ": " << msg << std::endl;
+    exit(1);
+  }
+
+  /// Make sure we have exactly one file for each shard.
+  inline void CheckShardSet(const emp::vector<std::string> & filenames,
+                            const emp::vector<ShardInfo> & shards) {
+    emp::vector<size_t> found(shards[0].count, 0);
+    for (size_t i = 0; i < shards.size(); i++) {
+      if (shards[i].count != shards[0].count) ShardError(filenames[i], "shard counts differ");
+      if (found[shards[i].id]++) ShardError(filenames[i], "shard " + shards[i].ToString() + " repeated");
+    }
+    if (shards.size() != shards[0].count) {
+      ShardError(filenames[0], "expected " + std::to_string(shards[0].count) + " shards, found "
+                               + std::to_string(shards.size()));
+    }
+  }
+
+  inline void MergeMulticellShards(std::ostream & os, const emp::vector<std::string> & filenames) {
+    struct Treatment {
+      std::string combo_string;
+      int restrain = 0;
+      size_t mc_size = 0;
+      emp::vector<RunResults> results;
+      emp::vector<char> found;
+    };
+    emp::vector<Treatment> treatments;
+    emp::vector<ShardInfo> shards;
+    std::string header;
+    bool print_reps = false;
+
+    for (const std::string & filename : filenames) {
+      std::ifstream fp_in(filename);
+      std::string line, tag;
+      std::getline(fp_in, line);
+      std::stringstream first_ss(line);
+      std::string shard_str;
+      first_ss >> tag >> shard_str;
+      shards.push_back(ShardInfo::FromString(shard_str));
+      const bool is_first = (shards.size() == 1);
+
+      while (std::getline(fp_in, line)) {
+        std::stringstream ss(line);
+        if (line.rfind("#print_reps ", 0) == 0) { ss >> tag >> print_reps; }
+        else if (line.rfind("#header ", 0) == 0) {
+          if (!is_first && line.substr(8) != header) ShardError(filename, "column headers differ");
+          header = line.substr(8);
+        }
+        else if (line.rfind("#combo ", 0) == 0) {
+          size_t combo_id, num_runs;
+          Treatment treatment;
+          ss >> tag >> combo_id >> num_runs >> treatment.restrain >> treatment.mc_size;
+          ss.get();  // Skip the separating space.
+          std::getline(ss, treatment.combo_string);
+          if (is_first) {
+            treatment.results.resize(num_runs);
+            treatment.found.resize(num_runs, 0);
+            treatments.push_back(treatment);
+          }
+          else if (combo_id >= treatments.size() ||
+                   treatments[combo_id].combo_string != treatment.combo_string) {
+            ShardError(filename, "treatments differ from " + filenames[0]);
+          }
+        }
+        else if (line.size() && line[0] != '#') {
+          size_t combo_id, rep_id;
+          ss >> combo_id >> rep_id;
+          ss.get();
+          std::string result_str;
+          std::getline(ss, result_str);
+          if (combo_id >= treatments.size() || rep_id >= treatments[combo_id].results.size()) {
+            ShardError(filename, "replicate out of range: " + line);
+          }
+          treatments[combo_id].results[rep_id] = ResultStore::FromLine(result_str);
+          treatments[combo_id].found[rep_id] = 1;
+        }
+      }
+    }
+    CheckShardSet(filenames, shards);
+
+    os << header << std::endl;
+    for (size_t combo_id = 0; combo_id < treatments.size(); combo_id++) {
+      const Treatment & treatment = treatments[combo_id];
+      for (char found : treatment.found) {
+        if (!found) ShardError(filenames[0], "treatment " + std::to_string(combo_id) + " is incomplete");
+      }
+      PrintTreatmentRow(os, treatment.combo_string, treatment.results, treatment.restrain,
+                        treatment.mc_size, print_reps);
+    }
+  }
+
+  inline void MergeEvolutionShards(std::ostream & os, const emp::vector<std::string> & filenames) {
+    emp::map<size_t, std::string> treatment_rows;   // All rows for each treatment, by combo id.
+    emp::vector<ShardInfo> shards;
+    size_t num_treatments = 0;
+
+    for (const std::string & filename : filenames) {
+      std::ifstream fp_in(filename);
+      std::string line, tag, shard_str;
+      std::getline(fp_in, line);
+      std::stringstream first_ss(line);
+      first_ss >> tag >> shard_str;
+      shards.push_back(ShardInfo::FromString(shard_str));
+
+      std::string * cur_rows = nullptr;
+      while (std::getline(fp_in, line)) {
+        std::stringstream ss(line);
+        if (line.rfind("#treatments ", 0) == 0) { ss >> tag >> num_treatments; }
+        else if (line.rfind("#treatment ", 0) == 0) {
+          size_t combo_id;
+          ss >> tag >> combo_id;
+          if (emp::Has(treatment_rows, combo_id)) {
+            ShardError(filename, "treatment " + std::to_string(combo_id) + " repeated");
+          }
+          cur_rows = &treatment_rows[combo_id];
+        }
+        else if (line.size() && line[0] != '#') {
+          if (!cur_rows) ShardError(filename, "data found before any treatment");
+          *cur_rows += line + "\n";
+        }
+      }
+    }
+    CheckShardSet(filenames, shards);
+    if (treatment_rows.size() != num_treatments) {
+      ShardError(filenames[0], "expected " + std::to_string(num_treatments) + " treatments, found "
+                               + std::to_string(treatment_rows.size()));
+    }
+
+    os << "#run_id,num_ones,count" << std::endl;
+    for (auto & [combo_id, rows] : treatment_rows) os << rows;
+  }
+}
+
+/// Handle "SpatialRestraint merge OUTFILE SHARDFILES..."; returns the exit code.
+inline int MergeShards(const emp::vector<std::string> & args) {
+  if (args.size() < 4) {
+    std::cerr << "Usage: " << args[0] << " merge OutputFile ShardFile1 ShardFile2 ..." << std::endl;
+    return 1;
+  }
+  emp::vector<std::string> filenames(args.begin() + 3, args.end());
+
+  // The first line of a shard file identifies what kind of data it holds.
+  std::ifstream fp_in(filenames[0]);
+  std::string tag, shard_str, type;
+  fp_in >> tag >> shard_str >> type;
+  if (tag != "#shard") internal::ShardError(filenames[0], "not a shard file");
+
+  std::ofstream os(args[2]);
+  if (type == "multicell") internal::MergeMulticellShards(os, filenames);
+  else if (type == "evolution") internal::MergeEvolutionShards(os, filenames);
+  else internal::ShardError(filenames[0], "unknown shard type '" + type + "'");
+  std::cout << "Merged " << filenames.size() << " shards into " << args[2] << std::endl;
+  return 0;
+}
+
+#endif
@@ -18,7 +18,12 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
 #include <set>
+#include <condition_variable>
+#include <mutex>
 
 #include "emp/config/SettingConfig.hpp"
 #include "emp/bits/BitVector.hpp"
@@ -29,7 +34,18 @@
 #include "emp/base/unordered_map.hpp"
 
 
+#include "AdaptiveSampling.h"
+#include "AsyncTextWriter.h"
+#include "BalancePredictor.h"
+#include "ColumnarIO.h"
+#include "CounterRNG.h"
+#include "FillTimeEstimator.h"
 #include "Multicell.h"
+#include "ResultStore.h"
+#include "SampleLibrary.h"
+#include "Shards.h"
+#include "StreamingStats.h"
+#include "WorkPool.h"
 
   /// Information about a full multi-cell organism
   struct Organism {
@@ -55,33 +71,66 @@
     /// Dimensions are GENOME_SIZE+1 -by- NUM_SAMPLES
     emp::unordered_map<int, emp::vector<double> > repro_cache;  
     int repro_cache_min, repro_cache_max;
+    /// Classes loaded from a library with per-genotype counts draw from only that many samples
+    /// (all others draw from num_samples, simulating any that are missing).
+    emp::unordered_map<int, size_t> sample_counts;
+    /// Which genotypes share a cache entry: the multicell's classes, or a loaded library's.
+    SampleClasses sample_classes;
+    /// If we have a persistent result store, how many of its samples have we pulled into the cache?
+    emp::unordered_map<int, size_t> store_used;
+
+    // Per-generation log (with verbose output or a trace); see Run().
+    static constexpr size_t LOG_CHUNK_BYTES = 65536;  ///< Text buffered before it is written.
+    size_t log_stride = 1;                     ///< Generations between log records.
+    AsyncTextWriter * log_writer = nullptr;    ///< Writes text logs in the background (if set).
+    ColumnWriter * gens_writer = nullptr;      ///< Takes binary log records instead of text (if set).
+    emp::vector<double> * gens_trace = nullptr; ///< Takes log records as rows of LOG_COLUMNS numbers (if set).
+    static constexpr size_t LOG_COLUMNS = 6;   ///< generation, ave_ones, ave_repro_time, min/max/var_ones
+    size_t log_combo_id = 0;                   ///< Treatment, for binary log records.
+    size_t log_run_id = 0;                     ///< Run, for binary log records.
 
     // Shared resources with Experiment
     Multicell & multicell;
     emp::Random & random;
     emp::StreamManager & stream_manager;
+    ResultStore & result_store;
 
     Population(size_t pop_size, int ancestor_1s, size_t _samples,
                Multicell & _mc, emp::Random & _rand, emp::StreamManager & _smanager, 
-              bool _enforce_data_bounds)
+              bool _enforce_data_bounds, ResultStore & _store)
       : orgs(pop_size, ancestor_1s), num_samples(_samples)
       , enforce_data_bounds(_enforce_data_bounds)
-      , repro_cache(), repro_cache_min(0), repro_cache_max(0)
-      , multicell(_mc), random(_rand), stream_manager(_smanager)
+      , repro_cache(), repro_cache_min(0), repro_cache_max(0), sample_classes(_mc.GetSampleClasses())
+      , multicell(_mc), random(_rand), stream_manager(_smanager), result_store(_store)
     {
     }
 
     // Fill the reproduction time distributions from samples stored on disk. 
-    // Only loads in what we actually find
+    // Only loads in what we actually find.  Genotypes with identical dynamics under the
+    // library's own settings (see SampleLibrary::LoadSampleClasses) share a cache entry,
+    // filled from the first of their files found (-l gives every member the same samples).
+    // If the library records per-genotype sample counts, each genotype is limited to its own.
     void LoadSamplesFromDisk(std::string samples_directory, int min_ones, int max_ones){
       std::cout << "Loading samples from disk!" << std::endl;
       std::cout << "Loading ones from " << min_ones <<  " to " << max_ones << std::endl;
+      const std::map<int, size_t> file_counts = SampleLibrary::LoadSampleCounts(samples_directory);
+      sample_classes = SampleLibrary::LoadSampleClasses(samples_directory);
+      std::set<int> classes_loaded;
       std::stringstream filename_stream;
       std::ifstream fp_in;
       std::string line;
       size_t line_count;
+      int class_min = min_ones, class_max = max_ones;
       // Attempt to load file for each value of ones [0, genome_size]
       for(int num_ones = min_ones; num_ones <= max_ones; ++num_ones){
+        const int class_ones = sample_classes.Get(num_ones);
+        class_min = std::min(class_min, class_ones);
+        class_max = std::max(class_max, class_ones);
+        emp::vector<double> & samples = repro_cache[class_ones];
+        const auto count_it = file_counts.find(num_ones);
+        const size_t target = (count_it == file_counts.end()) ? num_samples
+                                                               : std::min(num_samples, count_it->second);
+        if (classes_loaded.count(class_ones)) continue;   // Already loaded from an equivalent genotype.
         filename_stream.str("");
         filename_stream << samples_directory << num_ones << ".dat";
         fp_in.open(filename_stream.str(), std::ios::in);
@@ -101,22 +150,25 @@
           std::cerr << "Present in " << filename_stream.str() << ": " << line_count << std::endl;
           exit(1);
         } 
-        repro_cache[num_ones] = emp::vector<double>();
         // Resize cache to handle that many entries
-        repro_cache[num_ones].resize(line_count);
+        line_count = std::min(line_count, target);
+        samples.resize(line_count);
         // Reset file pointer to top of file
         fp_in.clear();
         fp_in.seekg(0, fp_in.beg);
         // Load samples one at a time
-        for(size_t val_idx = 0; val_idx < line_count; ++val_idx){
-            fp_in >> repro_cache[num_ones][val_idx];
+        for(size_t val_idx = 0; val_idx < samples.size(); ++val_idx){
+            fp_in >> samples[val_idx];
         }
-        std::cout << "Number ones: " << num_ones << "; Loaded samples: " 
-                  << repro_cache[num_ones].size() << std::endl;
+        classes_loaded.insert(class_ones);
+        if (count_it != file_counts.end() && samples.size()) sample_counts[class_ones] = samples.size();
+        std::cout << "Number ones: " << num_ones << "; Loaded samples: " << line_count;
+        if (class_ones != num_ones) std::cout << " (for all genotypes pooled with " << class_ones << ")";
+        std::cout << std::endl;
         fp_in.close();
       }
-      repro_cache_min = min_ones - 1;
-      repro_cache_max = max_ones + 1;
+      repro_cache_min = class_min - 1;
+      repro_cache_max = class_max + 1;
     }  
 
           void Reset(size_t pop_size, int ancestor_1s, bool reset_cache=true) {
@@ -128,6 +180,9 @@
               repro_cache.clear();
               repro_cache_min = 0;
               repro_cache_max = 0;
+              sample_counts.clear();
+              sample_classes = multicell.GetSampleClasses();
+              store_used.clear();
             }
           }
 
@@ -187,21 +242,52 @@
                             total_org.repro_time / (double) orgs.size());
           }
 
-          double CalcReproDuration(int num_ones) {
+          /// The cache of samples for a sample class, making sure the range of classes covers it.
+          emp::vector<double> & GetCache(int num_ones) {
             if(repro_cache_min >= num_ones){
               for(int i = repro_cache_min; i >= num_ones; --i)
-                    repro_cache[i] = emp::vector<double>();
-                repro_cache_min = num_ones - 1;
-              }
-              if(repro_cache_max <= num_ones){
-                for(int i = repro_cache_max; i <= num_ones; ++i)
-                    repro_cache[i] = emp::vector<double>();
-                repro_cache_max = num_ones + 1;
-              }
+                repro_cache[i] = emp::vector<double>();
+              repro_cache_min = num_ones - 1;
+            }
+            if(repro_cache_max <= num_ones){
+              for(int i = repro_cache_max; i <= num_ones; ++i)
+                repro_cache[i] = emp::vector<double>();
+              repro_cache_max = num_ones + 1;
+            }
+            return repro_cache[num_ones];
+          }
+
+          /// How many samples a sample class draws from.
+          size_t CountClassSamples(int num_ones) const {
+            if (sample_counts.size()) {
+              auto count_it = sample_counts.find(num_ones);
+              if (count_it != sample_counts.end()) return count_it->second;
+            }
+            return num_samples;
+          }
+
+          double CalcReproDuration(int num_ones) {
+            num_ones = sample_classes.Get(num_ones);   // Pool equivalent genotypes.
+            emp::vector<double> & cur_cache = GetCache(num_ones);
+            size_t sample_id = random.GetUInt(CountClassSamples(num_ones));
+            if (sample_id < cur_cache.size()) {
+              SR_PERF_COUNT(multicell.perf, cache_hits);
+              return cur_cache[sample_id];
+            }
+            SR_PERF_COUNT(multicell.perf, cache_misses);
+            return AddSample(num_ones, cur_cache);
+          }
+
+          /// All samples of a genotype's repro time, simulating any that are not cached yet.
+          const emp::vector<double> & GetSamples(int num_ones) {
+            num_ones = sample_classes.Get(num_ones);
+            emp::vector<double> & cur_cache = GetCache(num_ones);
+            while (cur_cache.size() < CountClassSamples(num_ones)) AddSample(num_ones, cur_cache);
+            return cur_cache;
+          }
 
-          emp::vector<double> & cur_cache = repro_cache[num_ones];
-          size_t sample_id = random.GetUInt(num_samples);
-          if (sample_id < cur_cache.size()) return cur_cache[sample_id];
+          /// Add a new sample to the cache for a sample class (from the result store if possible).
+          double AddSample(int num_ones, emp::vector<double> & cur_cache) {
           if(enforce_data_bounds){
               std::cout << "Error! requested sample that isn't pre-generated!" << std::endl;
               std::cout << "Number of ones: "<< num_ones << std::endl;
@@ -209,13 +295,29 @@
               exit(-1);
           }
 
+          // Use a sample from the persistent result store if there is one we haven't used yet.
+          size_t & used_count = store_used[num_ones];
+          if (used_count < result_store.CountResults(multicell, num_ones)) {
+            SR_PERF_COUNT(multicell.perf, store_hits);
+            double run_time = result_store.GetResult(multicell, num_ones, used_count++).GetReproTime();
+            cur_cache.push_back(run_time);
+            return run_time;
+          }
+
           std::cout << "calculating: " << num_ones << std::endl;
+          SR_PERF_COUNT(multicell.perf, inline_sims);
+          PerfTimer timer(multicell.perf.inline_sim_time);
           multicell.start_1s = num_ones;
           multicell.SetupConfig();
           multicell.InjectCell(multicell.MiddlePos());
-          double run_time = multicell.Run().GetReproTime();
+          RunResults results = multicell.Run();
+          double run_time = results.GetReproTime();
           // std::cout << "run_time = " << run_time << std::endl;
 
+          // Record the new sample so later runs can reuse it.
+          result_store.AddResult(multicell, num_ones, results);
+          used_count++;
+
           cur_cache.push_back(run_time);
           return run_time;
         }
@@ -278,6 +380,45 @@
           org_queue.Insert(offspring_id, offspring.repro_time);
         }
 
+        /// Add the record for a generation to the log (as text, unless there is a gens_trace or
+        /// gens_writer).
+        void LogGeneration(size_t gen, std::string & log_text) {
+          if (gens_trace) {
+            for (double value : { (double) gen, CalcAveOnes(), CalcAveReproDuration(), (double) CalcMinOnes(),
+                                  (double) CalcMaxOnes(), CalcVarOnes() }) {
+              gens_trace->push_back(value);
+            }
+            return;
+          }
+          if (gens_writer) {
+            *gens_writer << log_combo_id << log_run_id << gen << CalcAveOnes()
+                         << CalcAveReproDuration() << CalcMinOnes() << CalcMaxOnes() << CalcVarOnes();
+            gens_writer->EndRow();
+            return;
+          }
+          log_text += emp::to_string(gen,
+                                     ", ", CalcAveOnes(),
+                                     ", ", CalcAveReproDuration(),
+                                     ", ", CalcMinOnes(),
+                                     ", ", CalcMaxOnes(),
+                                     ", ", CalcVarOnes()
+                                    );
+          log_text += '\n';
+        }
+
+        /// Hand off logged text to its stream (and std::cout, if print_both), then clear it.
+        /// Text for std::cout is written right away, so it stays in order with other messages
+        /// (e.g. from AddSample); only files go to the log_writer.
+        void WriteLog(std::ostream & os, bool print_both, std::string & log_text) {
+          const bool to_cout = os.rdbuf() == std::cout.rdbuf();
+          if (print_both || to_cout) std::cout << log_text << std::flush;
+          if (!to_cout) {
+            if (log_writer) log_writer->Write(os, std::move(log_text));
+            else os << log_text << std::flush;
+          }
+          log_text.clear();
+        }
+
         void Run(double max_gen, const std::string run_name="", bool verbose=false) {
           // Setup the time queue.
           for (size_t i = 0; i < orgs.size(); i++) {
@@ -286,32 +427,32 @@
             orgs[i].repro_time = repro_time;
           }
 
-          // If verbose or print_reps is turned on, we need to track the current generation.
-          if (verbose || run_name.size()) {
-            std::ostream & os(stream_manager.get_ostream(run_name));
+          // If verbose or print_reps is turned on (or there is a gens_trace), we need to track
+          // the current generation.  Every log_stride generations a record is added to the
+          // log, which is handed off in chunks (written in the background if there is a
+          // log_writer).
+          if (verbose || run_name.size() || gens_trace) {
+            const bool has_stream = verbose || run_name.size();   // A trace alone prints nothing.
+            std::ostream * os = has_stream ? &stream_manager.get_ostream(run_name) : nullptr;
 
             bool print_both = verbose && run_name.size();  // Should we send output to both places?
 
-            os << "#generation, ave_ones, ave_repro_time, min_ones, max_ones, var_ones\n";
-            if (print_both) std::cout << "#generation, ave_ones, ave_repro_time, min_ones, max_ones, var_ones\n";
+            std::string log_text;                          // Text not yet handed off.
+            if (!gens_writer && !gens_trace) log_text = "#generation, ave_ones, ave_repro_time, min_ones, max_ones, var_ones\n";
 
             double next_gen = -1.0;
-            std::string out_line = "";
             while (ave_gen < max_gen) {
               if (ave_gen > next_gen) {
                 next_gen += 1.0;
-                out_line = emp::to_string((size_t) next_gen,
-                                          ", ", CalcAveOnes(),
-                                          ", ", CalcAveReproDuration(),
-                                          ", ", CalcMinOnes(),
-                                          ", ", CalcMaxOnes(),
-                                          ", ", CalcVarOnes()
-                                         );
-                os << out_line << std::endl;
-                if (print_both) std::cout << out_line << std::endl;
+                if ((size_t) next_gen % log_stride == 0) LogGeneration((size_t) next_gen, log_text);
+                if (os && log_text.size() >= LOG_CHUNK_BYTES) WriteLog(*os, print_both, log_text);
               }
               NextBirth();
             }
+            if (os) {
+              WriteLog(*os, print_both, log_text);
+              if (log_writer) log_writer->Flush();   // Finish before anything else is printed.
+            }
           }
 
           else {
@@ -321,6 +462,21 @@
           }
         }
 
+        /// Count up the number of organisms with each bit count.
+        emp::map<int, size_t> CountOnes() const {
+          emp::map<int, size_t> bit_map;
+          for (const Organism & org : orgs) bit_map[org.num_ones]++;
+          return bit_map;
+        }
+
+        /// Binary version of PrintData(): one (combo_id, run_id, num_ones, count) row per bit count.
+        void WriteData(size_t combo_id, size_t run_id, ColumnWriter & writer) const {
+          for (auto [num_ones, count] : CountOnes()) {
+            writer << combo_id << run_id << num_ones << count;
+            writer.EndRow();
+          }
+        }
+
         void PrintData(size_t run_id, std::ostream & os=std::cout) {
           // Count up the number of organism with each bit count.
           emp::map<int, size_t> bit_map;
@@ -345,13 +501,19 @@
     size_t gen_count = 0;             ///< Num generations to evolve (zero for analyze multicells)
     size_t pop_size = 200;            ///< Num organisms in the population.
     size_t sample_size = 100;         ///< Num multicells to sample for each genotype.
-    bool balance_predict = false;     ///< Try to predict the mutation-selection balance.
+    bool balance_predict = false;     ///< Predict the mutation-selection balance instead of evolving?
+    bool validate_approx = false;     ///< Compare approximate (-A) runs against exact ones?
     bool print_reps = false;          ///< Should we print results for every replicate?
+    bool streaming = false;           ///< Summarize replicates as they finish, without keeping them?
+    bool common_random = false;       ///< Share random streams across treatments (per replicate)?
+    bool antithetic = false;          ///< Pair replicates with mirrored timing jitter?
     bool print_trace = false;         ///< Should we show each step of a multicell?
     bool reset_cache = false;         ///< Share the cache by default.
     bool verbose = false;             ///< Should we print extra information during the run?
+    size_t log_stride = 1;            ///< Generations between per-generation log records (-v or -T)
     bool enforce_data_bounds = false; ///< If we are using pre-gen data and needed missing data, exit?
     int updates_per_frame = -1;       ///< Num cell updates in each gif frame (-1 for no gif)
+    size_t num_threads = 1;           ///< Threads for multicell replicates (0 = all hardware threads)
     size_t pixels_per_cell = -1;      ///< Number of pixels for each side of a cell in the gif
 
     emp::StreamManager stream_manager;  ///< Manage files
@@ -362,6 +524,23 @@
     int sample_input_min;               ///< If loading samples from file, this is the start index
     int sample_input_max;               ///< If loading samples from file, this is the final index
     int random_seed;                    ///< Random seed to use (-1 to seed randomly)
+    uint64_t run_seed = 0;              ///< Seed actually used; keys every replicate's stream
+    std::string result_store_directory; ///< Path for persistent multicell results (empty for none)
+    ResultStore result_store;           ///< Previously computed multicell results, keyed by config
+    std::string shard_string;           ///< Which piece of the sweep should we run? ("i/N")
+    ShardInfo shard;                    ///< Parsed version of shard_string
+    std::string output_format;          ///< Format for multicell/evolution data ("text" or "binary")
+    bool binary_output = false;         ///< Should data files be written as binary columns?
+    std::unique_ptr<ColumnWriter> data_writer;  ///< Binary multicell/evolution data (if used)
+    std::unique_ptr<ColumnWriter> reps_writer;  ///< Binary per-replicate multicell times (if used)
+    std::unique_ptr<ColumnWriter> gens_writer;  ///< Binary per-generation log records (if used)
+    AsyncTextWriter log_writer;                 ///< Writes per-generation text logs in the background
+    std::string build_samples_directory;  ///< Root of a sample library to build (empty for none)
+    std::string estimate_sizes;         ///< Smaller sizes to estimate -l samples from (empty for exact)
+    size_t anchor_runs = 10;            ///< Exact full-size runs of each anchor genotype when estimating
+    double adaptive_budget = 0.0;       ///< Fraction of -s samples per genotype for adaptive -l (0 = uniform)
+    std::string perf_report_filename;   ///< Output filename for per-treatment performance (empty for none)
+    std::shared_ptr<SampleCache> sample_cache = std::make_shared<SampleCache>();  ///< Loaded -L libraries (shared across a batch)
 
     using TreatmentResults = emp::vector<RunResults>;
     using MulticellResults = emp::vector<TreatmentResults>;
@@ -375,7 +554,7 @@
       // letters are used to control model parameters, while capital letters are used to control
       // output.  The one exception is -h for '--help' which is otherwise too standard.
       // The order below sets the order that combinations are tested in. 
-      // AVAILABLE OPTION FLAGS: jlq ADFGHJKNOQRSUVWXYZ
+      // AVAILABLE OPTION FLAGS: JQ
 
       config.AddComboSetting<size_t>("data_count", "Number of times to replicate each run", 'd') = { 100 };
       config.AddComboSetting("ancestor_1s", "How many 1s in starting cell?", 'a',
@@ -401,6 +580,10 @@
                        [this](){ multicell.one_check = true; } );
       config.AddAction("is_infinite", "Make genome infinite", 'I',
                         [this](){multicell.is_infinite = true; });
+      config.AddAction("compact", "Store cells in 8 bytes each, for very large multicells (no -T or -f)", 'q',
+                       [this](){ multicell.compact = true; } );
+      config.AddAction("morton", "Store cells in Morton (Z-curve) order for memory locality", 'Z',
+                       [this](){ multicell.morton = true; } );
       config.AddSetting("gen_count",   "Num generations to evolve (0=analyze only)", 'g',
                         gen_count, "NumGens") = { 0 };
       config.AddSetting("pop_size",    "Number of organisms in the population.", 'p',
@@ -409,12 +592,20 @@
                         sample_size, "NumSamples") = { 200 };
       config.AddSetting("load_samples", "Load pre-computer multicell data from directory", 'L',
                         sample_input_directory, "Path") = {"" };
-      config.AddSetting("load_samples_min", "Minimum one count of samples when loading with -L", 'y',
+      config.AddSetting("build_samples", "Build a sample library for -L in directory (ones from -y to -z)", 'l',
+                        build_samples_directory, "Path") = "";
+      config.AddSetting("estimate_sizes", "With -l, estimate samples by scaling up exact ones at these smaller cells_side values", 'X',
+                        estimate_sizes, "NumCells...") = "";
+      config.AddSetting("anchor_runs", "Exact full-size runs for each anchor genotype when estimating with -X", 'Y',
+                        anchor_runs, "NumRuns") = 10;
+      config.AddSetting("adaptive_budget", "With -l, build only this fraction of -s samples per genotype, spread to where they matter most (0 = uniform)", 'H',
+                        adaptive_budget, "Fraction") = 0.0;
+      config.AddSetting("load_samples_min", "Minimum one count of samples when loading with -L or -l, or predicting with -B", 'y',
                         sample_input_min, "LoadOnesMin") = {0};
-      config.AddSetting("load_samples_max", "Maximum one count of samples when loading with -L", 'z',
+      config.AddSetting("load_samples_max", "Maximum one count of samples when loading with -L or -l, or predicting with -B", 'z',
                         sample_input_max, "LoadOnesMax") = {100};
 
-      config.AddAction("balance_predict", "Predict the mutation-selection balance [NOT YET IMPLEMENTED!]", 'B',
+      config.AddAction("balance_predict", "Predict the mutation-selection balance of genotypes -y to -z numerically (to -E), instead of evolving", 'B',
                        [this](){ balance_predict = true; } );
       config.AddAction("help", "Print full list of options", 'h',
                        [this](){
@@ -431,12 +622,38 @@
                         config_filename, "Filename") = "config.dat";
       config.AddSetting("random_seed", "Random seed (-1 to seed randomly)", 'w',
                         random_seed, "Integer") = -1;
+      config.AddSetting("threads", "Threads to run multicell replicates on (0 = all; 1 = in order)", 'j',
+                        num_threads, "NumThreads") = 1;
+      config.AddSetting("domain_threads", "Threads to split each 2D multicell across, in strips (0 = all)", 'D',
+                        multicell.domain_threads, "NumThreads") = 1;
+      config.AddSetting("endgame_empty", "Once this few cells are empty, only simulate cells that can fill them (exact; 0 = never)", 'G',
+                        multicell.endgame_empty, "NumCells") = 0;
+      config.AddSetting("approx_window", "Run multicells approximately in time windows this long (0 = exact; max 100)", 'A',
+                        multicell.approx_window, "TimeUnits") = 0.0;
+      config.AddAction("validate_approx", "Report the bias of -A against exact runs for each treatment", 'U',
+                       [this](){ validate_approx = true; } );
+      config.AddSetting("output_format", "Format for -M/-E data: text, or binary (columns; -P reps go to <file>.reps)", 'F',
+                        output_format, "Format") = "text";
+      config.AddSetting("shard", "Only run shard i of N (combine outputs with 'merge')", 'S',
+                        shard_string, "Index/Count") = "";
+      config.AddSetting("result_store", "Directory to reuse and save multicell results across runs", 'R',
+                        result_store_directory, "Path") = "";
+      config.AddSetting("perf_report", "Filename for per-treatment timings (and counters, if built with 'make perf')", 'K',
+                        perf_report_filename, "Filename") = "";
       config.AddAction("print_reps", "Print data for each replicate", 'P',
                        [this](){ print_reps = true; } );
+      config.AddAction("streaming", "Summarize replicates as they finish (adds median, IQR and p99 columns)", 'N',
+                       [this](){ streaming = true; } );
+      config.AddAction("common_random", "Use common random numbers: replicate i of every treatment shares streams", 'V',
+                       [this](){ common_random = true; } );
+      config.AddAction("antithetic", "Pair replicates, mirroring the timing jitter of the second", 'W',
+                       [this](){ antithetic = true; } );
       config.AddAction("trace", "Show each step of replicates (multicell or population)", 'T',
                        [this](){ print_trace = true; } );
       config.AddAction("verbose", "Print extra information during the run", 'v',
                        [this](){ verbose = true; } );
+      config.AddSetting("log_stride", "Generations between per-generation records with -v or -T (binary with -F goes to <-E file>.gens)", 'O',
+                        log_stride, "NumGens") = 1;
       config.AddAction("enforce", "Enforces population stays within bounds of data loaded with -L. Exits if bounds exceeded", 'e',
                        [this](){ enforce_data_bounds= true; } );
       config.AddSetting("updates_per_frame", "Number of cells to update before we write another gif frame. -1 for no animation.", 'f',
@@ -466,42 +683,198 @@
       return multicell.Run(print_trace, updates_per_frame, std::cout, pixels_per_cell);
     }
 
-    TreatmentResults & RunTreatment(std::ostream & os=std::cout) {
+    /// Random seed for a replicate, from a counter-based stream keyed by the run's seed, so it
+    /// does not depend on which (or how many) other replicates are run, or in what order.
+    int GetReplicateSeed(size_t combo_id, size_t rep_id) const {
+      return CounterRNG::CalcReplicateSeed(run_seed, combo_id, rep_id);
+    }
+
+    /// Seed a multicell's random streams for a replicate.  With common random numbers (-V),
+    /// neighbor choice, timing jitter and mutations each get their own stream, shared by
+    /// replicate rep_id of every treatment, so treatments differ only where their settings make
+    /// them.  With antithetic pairs (-W), replicates 2k and 2k+1 share streams but the second
+    /// mirrors its timing jitter.
+    void SeedReplicate(Multicell & mc, size_t combo_id, size_t rep_id) const {
+      if (!common_random && !antithetic) {
+        mc.random.ResetSeed(GetReplicateSeed(combo_id, rep_id));
+        mc.sub_streams = false;
+        return;
+      }
+      const size_t key_combo = common_random ? 0 : combo_id;
+      const size_t key_rep = antithetic ? rep_id / 2 : rep_id;
+      mc.SeedStreams(CounterRNG::CalcReplicateSeed(run_seed, key_combo, key_rep, 1),
+                     CounterRNG::CalcReplicateSeed(run_seed, key_combo, key_rep, 2),
+                     CounterRNG::CalcReplicateSeed(run_seed, key_combo, key_rep, 3),
+                     antithetic && rep_id % 2 == 1);
+    }
+
+    /// Get the results of a replicate for the current treatment, reusing a stored result if
+    /// one exists; otherwise run a new multicell and store it.  Traces and animations always run.
+    RunResults GetMulticellResults(size_t rep_id) {
+      const bool watching = print_trace || updates_per_frame != -1;
+      const int num_ones = multicell.start_1s;
+      if (!watching && rep_id < result_store.CountResults(multicell, num_ones)) {
+        return result_store.GetResult(multicell, num_ones, rep_id);
+      }
+      RunResults results;
+      {
+        PerfTimer timer(multicell.perf.run_time);
+        SeedReplicate(multicell, config.GetComboID(), rep_id);
+        results = TestMulticell();
+      }
+      if (rep_id >= result_store.CountResults(multicell, num_ones)) {
+        result_store.AddResult(multicell, num_ones, results);
+      }
+      return results;
+    }
+
+    /// Run (or retrieve) all replicates of the current treatment.
+    TreatmentResults & RunTreatment() {
       const size_t num_runs = config.GetValue<size_t>("data_count");
       const size_t combo_id = config.GetComboID();
       TreatmentResults & treatment_results = base_results[combo_id];
       treatment_results.resize(num_runs);
 
-      // Conduct all replicates and output the information.    
+      // Conduct all replicates.
       for (size_t i = 0; i < num_runs; i++) {
-        treatment_results[i] = TestMulticell();
-        if (print_reps) os << ", " << treatment_results[i].GetReproTime();
+        if (verbose) std::cout << " ... run " << i << std::endl;
+        treatment_results[i] = GetMulticellResults(i);
       }
 
       return treatment_results;
     }
 
-    RunResults SummarizeTreatment(std::ostream & os=std::cout) {
+    /// Run (or retrieve) all replicates of the current treatment, keeping only their summary.
+    StreamingSummary SummarizeTreatment() {
       const size_t num_runs = config.GetValue<size_t>("data_count");
-      const size_t combo_id = config.GetComboID();
-
-      // Setup room for the data being collected.
-      TreatmentResults & treatment_results = base_results[combo_id];
-      treatment_results.resize(num_runs);
-
-      // Conduct all replicates and output the information.    
-      RunResults total_results(multicell.genome_size);
+      StreamingSummary summary;
       for (size_t i = 0; i < num_runs; i++) {
         if (verbose) std::cout << " ... run " << i << std::endl;
-        treatment_results[i] = TestMulticell();
-        if (print_reps) os << ", " << treatment_results[i].GetReproTime();
-        total_results += treatment_results[i];
+        summary.Add(GetMulticellResults(i));
+      }
+      return summary;
+    }
+
+    /// Output the summary of a finished treatment in the current output format.
+    void OutputTreatment(std::ostream & os, size_t combo_id, const std::string & combo_string,
+                         const TreatmentResults & treatment_results, int restrain, size_t mc_size) {
+      if (!binary_output) {
+        PrintTreatmentRow(os, combo_string, treatment_results, restrain, mc_size, print_reps);
+        return;
       }
 
-      return total_results /= (double) num_runs;
+      RunResults total_results(0);
+      for (size_t rep_id = 0; rep_id < treatment_results.size(); rep_id++) {
+        if (reps_writer) {
+          *reps_writer << combo_id << rep_id << treatment_results[rep_id].GetReproTime();
+          reps_writer->EndRow();
+        }
+        total_results += treatment_results[rep_id];
+      }
+      total_results /= (double) treatment_results.size();
+
+      *data_writer << combo_id;
+      for (const std::string & value : emp::slice(combo_string, ',')) *data_writer << std::stod(value);
+      *data_writer << total_results.GetReproTime()
+                   << (total_results.CountRestrained(restrain) / (double) mc_size);
+      data_writer->EndRow();
     }
 
-    /// Given the current configuration options, evolve a set of runs.
+    /// Output a streamed treatment summary (-N): the usual columns, then the standard deviation,
+    /// median, interquartile range and 99th percentile of replication times.
+    void OutputSummary(std::ostream & os, size_t combo_id, const std::string & combo_string,
+                       const StreamingSummary & summary, int restrain, size_t mc_size) {
+      const RunResults average = summary.GetAverage();
+      const double frac_restrain = average.CountRestrained(restrain) / (double) mc_size;
+      const double iqr = summary.q75.Get() - summary.q25.Get();
+      if (!binary_output) {
+        os << combo_string << ", " << average.GetReproTime() << ", " << frac_restrain
+           << ", " << summary.time.GetStdDev() << ", " << summary.median.Get()
+           << ", " << iqr << ", " << summary.p99.Get() << std::endl;
+        return;
+      }
+      *data_writer << combo_id;
+      for (const std::string & value : emp::slice(combo_string, ',')) *data_writer << std::stod(value);
+      *data_writer << average.GetReproTime() << frac_restrain << summary.time.GetStdDev()
+                   << summary.median.Get() << iqr << summary.p99.Get();
+      data_writer->EndRow();
+    }
+
+    /// Add a treatment's row to the performance report, if one was requested.
+    void ReportPerf(size_t combo_id, const std::string & combo_string, const PerfCounters & perf) {
+      const std::string filename = config.GetValue<std::string>("perf_report");
+      if (filename.empty()) return;
+      std::ostream & perf_os = stream_manager.get_ostream(filename);
+      perf_os << combo_id << ", " << combo_string << ", ";
+      perf.PrintRow(perf_os);
+      perf_os << std::endl;
+    }
+
+    /// Setup binary output files with the appropriate columns.
+    void OpenBinaryOutput(bool is_evolution) {
+      using columnar::Type;
+      if (is_evolution) {
+        data_writer = std::make_unique<ColumnWriter>(evolution_filename,
+          emp::vector<std::pair<std::string, Type>>{ {"combo_id", Type::INT64},
+            {"run_id", Type::INT64}, {"num_ones", Type::INT64}, {"count", Type::INT64} });
+        if (verbose || print_trace) {
+          gens_writer = std::make_unique<ColumnWriter>(evolution_filename + ".gens",
+            emp::vector<std::pair<std::string, Type>>{ {"combo_id", Type::INT64},
+              {"run_id", Type::INT64}, {"generation", Type::INT64}, {"ave_ones", Type::FLOAT64},
+              {"ave_repro_time", Type::FLOAT64}, {"min_ones", Type::INT64},
+              {"max_ones", Type::INT64}, {"var_ones", Type::FLOAT64} });
+        }
+        return;
+      }
+
+      emp::vector<std::pair<std::string, Type>> columns{ {"combo_id", Type::INT64} };
+      for (const std::string & name : emp::slice(config.GetComboHeaders(), ',')) {
+        columns.emplace_back(name, Type::FLOAT64);
+      }
+      columns.emplace_back("ave_time", Type::FLOAT64);
+      columns.emplace_back("frac_restrain", Type::FLOAT64);
+      if (streaming) {
+        for (const char * name : {"sd_time", "median_time", "iqr_time", "p99_time"}) {
+          columns.emplace_back(name, Type::FLOAT64);
+        }
+      }
+      data_writer = std::make_unique<ColumnWriter>(multicell_filename, columns);
+      if (print_reps) {
+        reps_writer = std::make_unique<ColumnWriter>(multicell_filename + ".reps",
+          emp::vector<std::pair<std::string, Type>>{ {"combo_id", Type::INT64},
+            {"rep_id", Type::INT64}, {"repro_time", Type::FLOAT64} });
+      }
+    }
+
+    /// If a sample directory was specified, load its pre-computed samples into a population
+    /// (or reuse them, if this batch has already loaded them).
+    void LoadSamples(Population & pop) {
+      if(sample_input_directory.length() > 1)
+      {
+          PerfTimer timer(multicell.perf.setup_time);
+          int min_ones = config.GetValue<int>("load_samples_min");
+          int max_ones = config.GetValue<int>("load_samples_max");
+          const std::string cache_key = SampleCache::CalcKey(sample_input_directory,
+                                                             min_ones, max_ones, pop.num_samples);
+          if (const SampleCache::Entry * entry = sample_cache->Find(cache_key)) {
+            std::cout << "Reusing samples already loaded from " << sample_input_directory << std::endl;
+            pop.repro_cache = entry->repro_cache;
+            pop.repro_cache_min = entry->repro_cache_min;
+            pop.repro_cache_max = entry->repro_cache_max;
+            pop.sample_counts = entry->sample_counts;
+            pop.sample_classes = entry->sample_classes;
+          }
+          else {
+            pop.LoadSamplesFromDisk(sample_input_directory, min_ones, max_ones);
+            sample_cache->Add(cache_key, { pop.repro_cache, pop.repro_cache_min, pop.repro_cache_max,
+                                           pop.sample_counts, pop.sample_classes });
+          }
+      }
+    }
+
+    /// Given the current configuration options, evolve a set of runs.  Unless caches are
+    /// independent (-i), runs share the population's sample cache, so run k draws samples that
+    /// runs 0 to k-1 simulated from their own streams, and only reproduces after them.
     void EvolveTreatment(std::ostream & os=std::cout) {
       const size_t num_runs = config.GetValue<size_t>("data_count");
       const size_t num_samples = config.GetValue<size_t>("sample_size");
@@ -510,38 +883,652 @@
       const size_t gen_count = config.GetValue<size_t>("gen_count");
 
       Population pop(pop_size, ancestor_1s, num_samples, multicell, random, stream_manager, 
-          enforce_data_bounds);
-      // If directory was specified, load in pre-computed sample data
-      if(sample_input_directory.length() > 1)
-      {
-          int min_ones = config.GetValue<int>("load_samples_min");
-          int max_ones = config.GetValue<int>("load_samples_max");
-          pop.LoadSamplesFromDisk(sample_input_directory, min_ones, max_ones);
-      }
+          enforce_data_bounds, result_store);
+      pop.log_stride = log_stride;
+      pop.log_writer = &log_writer;
+      pop.gens_writer = gens_writer.get();
+      pop.log_combo_id = config.GetComboID();
+      const std::string combo_string = config.CurComboString(", ");  // Before runs change start_1s.
+      multicell.perf = PerfCounters();
+      LoadSamples(pop);
       for (size_t run_id = 0; run_id < num_runs; run_id++) {
         std::cout << "START Treatment #" << config.GetComboID()
                   << " : Run " << run_id << std::endl;
         std::string run_name =
           print_trace ? emp::to_string('t',config.GetComboID(),'r',run_id,".dat") : "";
+        random.ResetSeed(GetReplicateSeed(config.GetComboID(), run_id));
         pop.Reset(pop_size, ancestor_1s, reset_cache);
-        pop.Run(gen_count, run_name, verbose);
-        pop.PrintData(run_id, os);             // Output data for THIS population.
+        pop.log_run_id = run_id;
+        {
+          PerfTimer timer(multicell.perf.run_time);
+          pop.Run(gen_count, run_name, verbose);
+        }
+        // Output data for THIS population.
+        PerfTimer timer(multicell.perf.output_time);
+        if (binary_output) pop.WriteData(config.GetComboID(), run_id, *data_writer);
+        else pop.PrintData(run_id, os);
+      }
+      ReportPerf(config.GetComboID(), combo_string, multicell.perf);
+    }
+
+    /// Run a single replicate on a worker's own multicell, using the settings from another
+    /// (the worker's random streams must already be seeded).
+    static RunResults RunReplicate(Multicell & mc, const Multicell & settings) {
+      mc.CopyConfig(settings);
+      mc.SetupConfig();
+      mc.InjectCell(mc.MiddlePos());
+      return mc.Run();
+    }
+
+    /// Run a single replicate from a single random seed.
+    static RunResults RunReplicate(Multicell & mc, emp::Random & mc_random,
+                                   const Multicell & settings, int seed) {
+      mc_random.ResetSeed(seed);
+      mc.sub_streams = false;
+      return RunReplicate(mc, settings);
+    }
+
+    /// Run every replicate of every configuration as a separate job on a work-stealing pool,
+    /// biggest multicells first.  Each replicate gets its own random seed (see GetReplicateSeed),
+    /// so results do not depend on the number of threads (or shards).  Rows are
+    /// buffered and output in treatment order as soon as all earlier treatments are done.
+    /// When streaming (-N), replicates are instead folded into their treatment's summary in
+    /// order, holding only those that finish ahead of an earlier replicate.
+    void RunMulticellsParallel(std::ostream & os) {
+      struct Treatment {
+        std::string combo_string;   ///< Setting values, for output.
+        std::string label;          ///< Multi-valued settings with names, for progress messages.
+        Multicell settings;         ///< Copy of the multicell settings for this treatment.
+        size_t num_runs = 0;        ///< How many replicates in total?
+        size_t first_unit = 0;      ///< Unit id of replicate 0 (for deciding shard membership).
+        size_t num_stored = 0;      ///< How many replicates come from the result store?
+        size_t num_jobs = 0;        ///< How many replicates need to be run here?
+        size_t num_done = 0;        ///< How many of those jobs are finished?
+        PerfCounters perf;          ///< Counters and timings, combined across jobs.
+        StreamingSummary summary;   ///< Replicates so far, if streaming.
+        std::map<size_t, RunResults> early_results;  ///< Finished ahead of an earlier replicate.
+      };
+      emp::vector<Treatment> treatments;
+
+      size_t num_units = 0;
+      config.ResetCombos();
+      do {
+        const size_t combo_id = config.GetComboID();
+        const size_t num_runs = config.GetValue<size_t>("data_count");
+        Treatment treatment{ config.CurComboString(", "), config.CurComboString(", ", true, true),
+                             multicell, num_runs, num_units };
+        num_units += num_runs;
+
+        // Pull in as many replicates from the result store as we can.
+        PerfTimer timer(treatment.perf.setup_time);
+        TreatmentResults & treatment_results = base_results[combo_id];
+        if (!streaming) treatment_results.resize(num_runs);
+        const size_t num_stored = result_store.CountResults(multicell, multicell.start_1s);
+        while (treatment.num_stored < std::min(num_runs, num_stored)) {
+          const size_t rep_id = treatment.num_stored++;
+          RunResults stored = result_store.GetResult(multicell, multicell.start_1s, rep_id);
+          if (streaming) treatment.summary.Add(stored);
+          else treatment_results[rep_id] = stored;
+        }
+        treatments.push_back(treatment);
+
+        if (shard.active) {
+          os << "#combo " << combo_id << " " << num_runs << " " << multicell.restrain << " "
+             << multicell.GetSize() << " " << treatment.combo_string << std::endl;
+        }
+      } while (config.NextCombo());
+
+      // Queue up all remaining replicates in this shard, biggest multicells first.
+      struct Job { size_t combo_id; size_t rep_id; size_t cost; };
+      emp::vector<Job> jobs;
+      for (size_t combo_id = 0; combo_id < treatments.size(); combo_id++) {
+        Treatment & treatment = treatments[combo_id];
+        for (size_t rep_id = treatment.num_stored; rep_id < treatment.num_runs; rep_id++) {
+          if (!shard.Has(treatment.first_unit + rep_id)) continue;
+          jobs.push_back(Job{combo_id, rep_id, treatment.settings.GetSize()});
+          treatment.num_jobs++;
+        }
+      }
+      std::stable_sort(jobs.begin(), jobs.end(),
+                       [](const Job & a, const Job & b){ return a.cost > b.cost; });
+
+      WorkPool pool(num_threads);
+      emp::vector<emp::Random> worker_randoms(pool.GetNumWorkers());
+      emp::vector<Multicell> worker_multicells;
+      for (emp::Random & worker_random : worker_randoms) worker_multicells.emplace_back(worker_random);
+
+      std::mutex done_mutex;
+      std::condition_variable done_cv;
+      for (const Job & job : jobs) {
+        pool.AddJob([this, job, &treatments, &worker_randoms, &worker_multicells,
+                     &done_mutex, &done_cv](size_t worker_id){
+          Treatment & treatment = treatments[job.combo_id];
+          Multicell & mc = worker_multicells[worker_id];
+          mc.perf = PerfCounters();
+          RunResults results;
+          {
+            PerfTimer timer(mc.perf.run_time);
+            SeedReplicate(mc, job.combo_id, job.rep_id);
+            results = RunReplicate(mc, treatment.settings);
+          }
+          std::lock_guard<std::mutex> lock(done_mutex);
+          if (streaming) {    // Fold in this replicate and any that were waiting on it.
+            treatment.early_results[job.rep_id] = std::move(results);
+            auto it = treatment.early_results.begin();
+            while (it != treatment.early_results.end() &&
+                   it->first == treatment.num_stored + treatment.num_done) {
+              result_store.AddResult(treatment.settings, treatment.settings.start_1s, it->second);
+              treatment.summary.Add(it->second);
+              treatment.num_done++;
+              it = treatment.early_results.erase(it);
+            }
+          }
+          else {
+            base_results[job.combo_id][job.rep_id] = std::move(results);
+            treatment.num_done++;
+          }
+          treatment.perf += mc.perf;
+          done_cv.notify_one();
+        });
+      }
+      pool.Start();
+
+      // Output treatments in order as they finish.
+      for (size_t combo_id = 0; combo_id < treatments.size(); combo_id++) {
+        Treatment & treatment = treatments[combo_id];
+        {
+          std::unique_lock<std::mutex> lock(done_mutex);
+          done_cv.wait(lock, [&treatment](){ return treatment.num_done == treatment.num_jobs; });
+        }
+        std::cout << "DONE Treatment #" << combo_id << " / " << treatments.size() << std::endl
+                  << "  " << treatment.label << std::endl;
+        const TreatmentResults & treatment_results = base_results[combo_id];
+        PerfTimer timer(treatment.perf.output_time);
+
+        // Shards output raw replicates to be merged later.
+        if (shard.active) {
+          for (size_t rep_id = 0; rep_id < treatment_results.size(); rep_id++) {
+            if (!shard.Has(treatment.first_unit + rep_id)) continue;
+            os << combo_id << " " << rep_id << " "
+               << ResultStore::ToLine(treatment_results[rep_id]) << "\n";
+          }
+          os.flush();
+        }
+
+        else if (streaming) {
+          OutputSummary(os, combo_id, treatment.combo_string, treatment.summary,
+                        treatment.settings.restrain, treatment.settings.GetSize());
+        }
+
+        // Otherwise, save new replicates (in order) for future runs, and output the treatment.
+        else {
+          const int num_ones = treatment.settings.start_1s;
+          for (size_t rep_id = treatment.num_stored; rep_id < treatment_results.size(); rep_id++) {
+            result_store.AddResult(treatment.settings, num_ones, treatment_results[rep_id]);
+          }
+          OutputTreatment(os, combo_id, treatment.combo_string, treatment_results,
+                          treatment.settings.restrain, treatment.settings.GetSize());
+        }
+      }
+
+      if (config.GetValue<std::string>("perf_report").size()) {
+        for (size_t combo_id = 0; combo_id < treatments.size(); combo_id++) {
+          ReportPerf(combo_id, treatments[combo_id].combo_string, treatments[combo_id].perf);
+        }
+      }
+      pool.Wait();
+    }
+
+    /// Build (or extend) a library of reproduction-time samples, as loaded by -L, for every
+    /// treatment and every number of ones from load_samples_min to load_samples_max.  All
+    /// samples run as separate jobs on a pool of threads.  Each sample's seed depends only on
+    /// the random seed, its genotype and its index, and genotypes are only written once all of
+    /// their samples are done, so an interrupted (or extended) build can be rerun to pick up
+    /// where it left off with identical results.  Genotypes with identical dynamics (see
+    /// Multicell::GetSampleClass) are simulated once, as a class, and every member's file gets
+    /// the class's samples.  Classes are seeded by their representative genotype, so extending
+    /// the range of ones never changes them; a new member's file is copied from the class's
+    /// existing samples, and only samples that no member has yet are simulated.  A cells_side other than zero replaces the size of every treatment.
+    /// If get_target is given, it sets how many samples each class should have instead (up to
+    /// sample_size; it is passed the class's settings), and the counts are recorded in each
+    /// treatment's sample_counts.txt for loading (as they are whenever that file already exists).
+    void BuildSampleLibrary(const std::string & root, uint64_t base_seed, size_t cells_side=0,
+                            std::function<size_t(const Multicell &)> get_target=nullptr) {
+      const int min_ones = config.GetValue<int>("load_samples_min");
+      const int max_ones = config.GetValue<int>("load_samples_max");
+      const size_t num_samples = config.GetValue<size_t>("sample_size");
+
+      struct SampleClass {
+        Multicell settings;         ///< Multicell settings, with start_1s at the class's representative.
+        size_t max_existing = 0;    ///< Most samples already on disk for any member.
+        std::string existing_file;  ///< The member that has them.
+        size_t target = 0;          ///< How many samples should every member have?
+        emp::vector<double> new_samples;  ///< Samples produced in this run.
+        size_t num_done = 0;        ///< How many of the new samples are finished?
+      };
+      struct Genotype {
+        std::string filename;       ///< Where do samples for this genotype go?
+        std::string treatment_dir;
+        int num_ones;
+        size_t class_id;            ///< Which class of equivalent genotypes is this one in?
+        size_t num_existing = 0;    ///< How many samples are already on disk?
+      };
+      emp::vector<SampleClass> classes;
+      emp::vector<Genotype> genotypes;
+      std::set<std::string> treatments_seen;   // Skip combos that differ only in unused settings.
+
+      config.ResetCombos();
+      do {
+        if (cells_side) multicell.cells_side = cells_side;
+        if (!treatments_seen.insert(SampleLibrary::GetSettingsString(multicell)).second) continue;
+        const std::string treatment_dir = SampleLibrary::GetTreatmentDir(root, multicell);
+        SampleLibrary::PrepareTreatmentDir(treatment_dir, multicell);
+        std::map<int, size_t> class_ids;       // Sample class -> position in classes
+        for (int num_ones = min_ones; num_ones <= max_ones; num_ones++) {
+          Genotype genotype{ SampleLibrary::GetSampleFilename(treatment_dir, num_ones), treatment_dir,
+                             num_ones, classes.size() };
+          genotype.num_existing = std::min(num_samples, SampleLibrary::CountSamples(genotype.filename));
+          const int class_ones = multicell.GetSampleClass(num_ones);
+          auto [it, is_new] = class_ids.emplace(class_ones, classes.size());
+          genotype.class_id = it->second;
+          if (is_new) {
+            classes.push_back(SampleClass{ multicell });
+            classes.back().settings.start_1s = class_ones;
+          }
+          SampleClass & sample_class = classes[genotype.class_id];
+          if (is_new || genotype.num_existing > sample_class.max_existing) {
+            sample_class.max_existing = genotype.num_existing;
+            sample_class.existing_file = genotype.filename;
+          }
+          genotypes.push_back(genotype);
+        }
+      } while (config.NextCombo());
+
+      // Queue up all missing samples, biggest multicells first.
+      struct Job { size_t class_id; size_t sample_id; size_t cost; };
+      emp::vector<Job> jobs;
+      for (size_t class_id = 0; class_id < classes.size(); class_id++) {
+        SampleClass & sample_class = classes[class_id];
+        sample_class.target = get_target ? std::min(num_samples, get_target(sample_class.settings)) : num_samples;
+        sample_class.new_samples.resize(sample_class.target - std::min(sample_class.target, sample_class.max_existing));
+        for (size_t sample_id = 0; sample_id < sample_class.new_samples.size(); sample_id++) {
+          jobs.push_back(Job{class_id, sample_id, sample_class.settings.GetSize()});
+        }
+      }
+      std::stable_sort(jobs.begin(), jobs.end(),
+                       [](const Job & a, const Job & b){ return a.cost > b.cost; });
+
+      WorkPool pool(num_threads);
+      emp::vector<emp::Random> worker_randoms(pool.GetNumWorkers());
+      emp::vector<Multicell> worker_multicells;
+      for (emp::Random & worker_random : worker_randoms) worker_multicells.emplace_back(worker_random);
+
+      std::mutex done_mutex;
+      std::condition_variable done_cv;
+      for (const Job & job : jobs) {
+        pool.AddJob([job, base_seed, &classes, &worker_randoms, &worker_multicells,
+                     &done_mutex, &done_cv](size_t worker_id){
+          SampleClass & sample_class = classes[job.class_id];
+          const int seed = SampleLibrary::CalcSampleSeed(base_seed, sample_class.settings,
+                                                         sample_class.max_existing + job.sample_id);
+          sample_class.new_samples[job.sample_id] =
+            RunReplicate(worker_multicells[worker_id], worker_randoms[worker_id],
+                         sample_class.settings, seed).GetReproTime();
+          std::lock_guard<std::mutex> lock(done_mutex);
+          sample_class.num_done++;
+          done_cv.notify_one();
+        });
+      }
+      std::cout << "Building " << jobs.size() << " samples for " << genotypes.size()
+                << " genotypes (" << classes.size() << " classes) on "
+                << pool.GetNumWorkers() << " threads." << std::endl;
+      pool.Start();
+
+      // Write out each genotype once all of its class's samples are done.
+      std::map<std::string, std::map<int, size_t>> treatment_counts;   // Only for recorded counts.
+      for (Genotype & genotype : genotypes) {
+        const SampleClass & sample_class = classes[genotype.class_id];
+        {
+          std::unique_lock<std::mutex> lock(done_mutex);
+          done_cv.wait(lock, [&sample_class](){
+            return sample_class.num_done == sample_class.new_samples.size();
+          });
+        }
+        if (get_target || std::filesystem::exists(SampleLibrary::GetCountsFilename(genotype.treatment_dir))) {
+          treatment_counts[genotype.treatment_dir][genotype.num_ones] =
+            std::max(genotype.num_existing, sample_class.target);
+        }
+        // Samples another member already has are copied; the rest were just simulated.
+        if (genotype.num_existing >= sample_class.target) continue;
+        const size_t num_copied = std::min(sample_class.target, sample_class.max_existing);
+        emp::vector<double> new_samples;
+        if (genotype.num_existing < num_copied) {
+          new_samples = SampleLibrary::LoadSamples(sample_class.existing_file, num_copied);
+          new_samples.erase(new_samples.begin(), new_samples.begin() + genotype.num_existing);
+        }
+        new_samples.insert(new_samples.end(), sample_class.new_samples.begin(), sample_class.new_samples.end());
+        SampleLibrary::AppendSamples(genotype.filename, new_samples);
+        std::cout << "Wrote " << new_samples.size() << " samples to "
+                  << genotype.filename << std::endl;
+      }
+      pool.Wait();
+      for (auto & [treatment_dir, counts] : treatment_counts) {
+        std::map<int, size_t> all_counts = SampleLibrary::LoadSampleCounts(treatment_dir);
+        for (auto [num_ones, count] : counts) all_counts[num_ones] = count;
+        SampleLibrary::SaveSampleCounts(treatment_dir, all_counts);
+      }
+      sample_cache->Clear();   // Any library loaded earlier (in a batch) may have grown.
+    }
+
+    /// Build a sample library (as -l would) spending only adaptive_budget of the uniform number
+    /// of samples (sample_size for every genotype).  A third of it goes to a pilot sample of each
+    /// class of genotypes; the rest goes to classes in proportion to their weights from the
+    /// pilots (see AdaptiveSampling.h).  Samples are the same ones an exact build would make (the
+    /// first N of them), so a library can later be extended to full size.  Each treatment
+    /// directory gets an allocation.csv with every class's weights and sample count, and a
+    /// sample_counts.txt so that -L draws from each genotype's own samples.
+    void AdaptSampleLibrary(const std::string & root, uint64_t base_seed) {
+      const int min_ones = config.GetValue<int>("load_samples_min");
+      const int max_ones = config.GetValue<int>("load_samples_max");
+      const size_t num_samples = config.GetValue<size_t>("sample_size");
+      const size_t pilot_size =
+        std::clamp<size_t>((size_t) (adaptive_budget * num_samples / 3.0), std::min<size_t>(2, num_samples), num_samples);
+      BuildSampleLibrary(root, base_seed, 0, [pilot_size](const Multicell &){ return pilot_size; });
+
+      std::map<std::string, size_t> targets;   // Sample class (as a ResultStore key) -> samples
+      std::set<std::string> treatments_seen;
+      config.ResetCombos();
+      do {
+        if (!treatments_seen.insert(SampleLibrary::GetSettingsString(multicell)).second) continue;
+        const std::string treatment_dir = SampleLibrary::GetTreatmentDir(root, multicell);
+        emp::vector<int> class_ones;   // First member of each class, in order of ones.
+        std::set<int> classes_seen;
+        for (int num_ones = min_ones; num_ones <= max_ones; num_ones++) {
+          if (classes_seen.insert(multicell.GetSampleClass(num_ones)).second) class_ones.push_back(num_ones);
+        }
+        emp::vector<emp::vector<double>> pilots;
+        for (int num_ones : class_ones) {
+          pilots.push_back(SampleLibrary::LoadSamples(
+            SampleLibrary::GetSampleFilename(treatment_dir, num_ones), pilot_size));
+        }
+        const emp::vector<AdaptiveSampling::Weight> weights = AdaptiveSampling::CalcWeights(pilots);
+        const size_t budget = (size_t) std::round(adaptive_budget * num_samples * class_ones.size());
+        const emp::vector<size_t> counts =
+          AdaptiveSampling::Allocate(weights, pilot_size, budget, num_samples);
+
+        std::ofstream report(treatment_dir + "allocation.csv");
+        report << "num_ones,cv,neighbor_dist,weight,samples" << std::endl;
+        for (size_t i = 0; i < class_ones.size(); i++) {
+          Multicell settings(multicell);
+          settings.start_1s = multicell.GetSampleClass(class_ones[i]);
+          targets[ResultStore::CalcKey(settings, settings.start_1s)] = counts[i];
+          report << class_ones[i] << "," << weights[i].cv << "," << weights[i].neighbor_dist << ","
+                 << weights[i].GetTotal() << "," << counts[i] << std::endl;
+        }
+        size_t total = 0;
+        for (size_t count : counts) total += count;
+        std::cout << "Allocated " << total << " samples to " << class_ones.size() << " classes in "
+                  << treatment_dir << " (" << *std::min_element(counts.begin(), counts.end())
+                  << " to " << *std::max_element(counts.begin(), counts.end()) << " each)." << std::endl;
+        if (total > budget) {
+          std::cout << "WARNING: The pilot samples alone exceed the budget of " << budget
+                    << "; raise -H or -s to leave room for adaptive allocation." << std::endl;
+        }
+      } while (config.NextCombo());
+
+      BuildSampleLibrary(root, base_seed, 0, [&targets](const Multicell & settings){
+        return targets.at(ResultStore::CalcKey(settings, settings.start_1s));
+      });
+    }
+
+    /// Estimate a sample library (as -l would build it) at each treatment's cells_side, by
+    /// scaling up exact libraries at the smaller sizes listed in -X, which are built (or
+    /// extended) first.  A few anchor genotypes are also run exactly at the full size (-Y runs
+    /// each) to correct the extrapolation; see FillTimeEstimator.h.  Each treatment directory
+    /// gets an estimate.csv with the estimated mean, standard deviation and relative error of
+    /// every genotype, and its settings.txt notes the estimate so exact samples are never mixed in.
+    void EstimateSampleLibrary(const std::string & root, uint64_t base_seed) {
+      const int min_ones = config.GetValue<int>("load_samples_min");
+      const int max_ones = config.GetValue<int>("load_samples_max");
+      const size_t num_samples = config.GetValue<size_t>("sample_size");
+      emp::vector<size_t> sides;
+      for (const std::string & side : emp::slice(estimate_sizes, ',')) sides.push_back(std::stoul(side));
+      std::sort(sides.begin(), sides.end());
+      if (sides.size() < 2 || anchor_runs < 2 || num_samples < 2) {
+        std::cerr << "ERROR: Estimating samples (-X) needs at least two smaller sizes, "
+                  << "two anchor runs (-Y) and two samples (-s)." << std::endl;
+        exit(1);
       }
+      for (size_t side : sides) BuildSampleLibrary(root, base_seed, side);
+
+      // Gather every full-size treatment, checking that it is bigger than all the small sizes.
+      emp::vector<Multicell> treatments;
+      std::set<std::string> treatments_seen;
+      config.ResetCombos();
+      do {
+        if (!treatments_seen.insert(SampleLibrary::GetSettingsString(multicell)).second) continue;
+        if (multicell.cells_side <= sides.back()) {
+          std::cerr << "ERROR: Sizes to estimate from (-X) must be smaller than cells_side "
+                    << multicell.cells_side << "." << std::endl;
+          exit(1);
+        }
+        treatments.push_back(multicell);
+      } while (config.NextCombo());
+
+      for (const Multicell & treatment : treatments) {
+        EstimateTreatmentSamples(root, base_seed, treatment, sides, min_ones, max_ones, num_samples);
+      }
+      sample_cache->Clear();
+    }
+
+    /// Estimate the samples of a single treatment; see EstimateSampleLibrary().
+    void EstimateTreatmentSamples(const std::string & root, uint64_t base_seed,
+                                  const Multicell & treatment, const emp::vector<size_t> & sides,
+                                  int min_ones, int max_ones, size_t num_samples) {
+      using namespace FillTimeEstimator;
+      struct SampleClass {
+        int first_ones;                 ///< First genotype in the class (whose files it reads).
+        SizeModel mean_model, sd_model; ///< Fill-time mean and standard deviation by size.
+        emp::vector<double> shape;      ///< Standardized samples at the largest small size.
+        RunningStats anchor;            ///< Exact full-size runs (if this is an anchor class).
+      };
+      std::map<int, SampleClass> classes;   // Keyed by Multicell::GetSampleClass()
+
+      // Fit every class's statistics across the small sizes.
+      for (int num_ones = min_ones; num_ones <= max_ones; num_ones++) {
+        auto [it, is_new] = classes.emplace(treatment.GetSampleClass(num_ones), SampleClass{num_ones});
+        if (!is_new) continue;
+        emp::vector<double> side_values, means, sds;
+        for (size_t side : sides) {
+          Multicell small(treatment);
+          small.cells_side = side;
+          const emp::vector<double> samples = SampleLibrary::LoadSamples(SampleLibrary::GetSampleFilename(
+            SampleLibrary::GetTreatmentDir(root, small), num_ones), num_samples);
+          RunningStats stats;
+          for (double sample : samples) stats.Add(sample);
+          side_values.push_back((double) side);
+          means.push_back(stats.GetMean());
+          sds.push_back(stats.GetStdDev());
+          if (side == sides.back()) {
+            for (double sample : samples) {
+              it->second.shape.push_back(stats.GetStdDev() > 0.0 ? (sample - stats.GetMean()) / stats.GetStdDev() : 0.0);
+            }
+          }
+        }
+        it->second.mean_model = SizeModel::Fit(side_values, means);
+        // Standard deviations are too noisy to extrapolate (a three-term fit of a few hundred
+        // samples per size can be off by a factor of two), so take the largest small size's
+        // as is, and leave its growth to the anchor corrections.
+        it->second.sd_model = SizeModel{ sds.back() };
+      }
+
+      // Run the anchor genotypes exactly, with the seeds a full build would give them.
+      const emp::vector<int> anchor_ones = ChooseAnchors(min_ones, max_ones, treatment.restrain);
+      std::set<int> anchor_classes;
+      for (int num_ones : anchor_ones) anchor_classes.insert(treatment.GetSampleClass(num_ones));
+      WorkPool pool(num_threads);
+      emp::vector<emp::Random> worker_randoms(pool.GetNumWorkers());
+      emp::vector<Multicell> worker_multicells;
+      for (emp::Random & worker_random : worker_randoms) worker_multicells.emplace_back(worker_random);
+      emp::vector<emp::vector<double>> anchor_times(anchor_classes.size(), emp::vector<double>(anchor_runs));
+      size_t anchor_id = 0;
+      for (int class_ones : anchor_classes) {
+        Multicell settings(treatment);
+        settings.start_1s = class_ones;
+        for (size_t run_id = 0; run_id < anchor_runs; run_id++) {
+          emp::vector<double> & times = anchor_times[anchor_id];
+          pool.AddJob([settings, run_id, base_seed, &times, &worker_randoms, &worker_multicells](size_t worker_id){
+            const int seed = SampleLibrary::CalcSampleSeed(base_seed, settings, run_id);
+            times[run_id] = RunReplicate(worker_multicells[worker_id], worker_randoms[worker_id],
+                                         settings, seed).GetReproTime();
+          });
+        }
+        anchor_id++;
+      }
+      std::cout << "Estimating cells_side " << treatment.cells_side << " from sizes " << estimate_sizes
+                << " with " << anchor_classes.size() << " anchor genotypes ("
+                << anchor_runs << " exact runs each) on " << pool.GetNumWorkers() << " threads." << std::endl;
+      pool.Start();
+      pool.Wait();
+
+      // Corrections (exact / extrapolated) at the anchors, and how well they predict each other.
+      emp::vector<std::pair<int, double>> corrections, sd_corrections;
+      double max_anchor_error = 0.0;
+      anchor_id = 0;
+      for (int class_ones : anchor_classes) {
+        SampleClass & sample_class = classes.at(class_ones);
+        for (double time : anchor_times[anchor_id++]) sample_class.anchor.Add(time);
+        const double fit_mean = sample_class.mean_model.Predict(treatment.cells_side);
+        corrections.emplace_back(class_ones, sample_class.anchor.GetMean() / fit_mean);
+        sd_corrections.emplace_back(class_ones,
+          sample_class.anchor.GetStdDev() / sample_class.sd_model.Predict(treatment.cells_side));
+        max_anchor_error = std::max(max_anchor_error, std::abs(corrections.back().second - 1.0));
+      }
+      // With too few anchors to cross-check, the corrections themselves bound the error.
+      double interp_error = CalcLeaveOneOutError(corrections);
+      if (interp_error < 0.0) interp_error = max_anchor_error;
+
+      // Write out every genotype, with a report.
+      const std::string treatment_dir = SampleLibrary::GetTreatmentDir(root, treatment);
+      SampleLibrary::PrepareTreatmentDir(treatment_dir, treatment, " estimated_from=" + estimate_sizes
+                                         + " anchor_runs=" + std::to_string(anchor_runs));
+      std::ofstream report(treatment_dir + "estimate.csv");
+      report << "num_ones,anchor,fit_mean,correction,mean,fit_sd,sd_correction,sd,rel_error" << std::endl;
+      double total_sq_error = 0.0;
+      for (int num_ones = min_ones; num_ones <= max_ones; num_ones++) {
+        const int class_ones = treatment.GetSampleClass(num_ones);
+        const SampleClass & sample_class = classes.at(class_ones);
+        const bool is_anchor = anchor_classes.count(class_ones);
+        const double fit_mean = sample_class.mean_model.Predict(treatment.cells_side);
+        const double correction = Interpolate(corrections, class_ones);
+        const double mean = fit_mean * correction;
+        const double fit_sd = sample_class.sd_model.Predict(treatment.cells_side);
+        const double sd_correction = Interpolate(sd_corrections, class_ones);
+        const double sd = fit_sd * sd_correction;
+        const double rel_error = is_anchor ?
+          sample_class.anchor.GetStdDev() / std::sqrt((double) anchor_runs) / sample_class.anchor.GetMean() :
+          interp_error;
+        total_sq_error += rel_error * rel_error;
+        report << num_ones << "," << is_anchor << "," << fit_mean << "," << correction << ","
+               << mean << "," << fit_sd << "," << sd_correction << "," << sd << "," << rel_error << std::endl;
+
+        emp::vector<double> samples;
+        for (double z : sample_class.shape) samples.push_back(std::max(mean + sd * z, 0.01 * mean));
+        SampleLibrary::AppendSamples(SampleLibrary::GetSampleFilename(treatment_dir, num_ones), samples, true);
+      }
+      std::cout << "Wrote " << (max_ones - min_ones + 1) << " estimated genotypes to " << treatment_dir
+                << "; extrapolation was off by up to " << 100.0 * max_anchor_error
+                << "% at anchors; estimated error of means " << 100.0 * interp_error
+                << "% between anchors (RMS over genotypes "
+                << 100.0 * std::sqrt(total_sq_error / (max_ones - min_ones + 1)) << "%)." << std::endl;
+    }
+
+    /// Measure the bias of approximate runs (-A) on every treatment: each replicate is run both
+    /// exactly and approximately from the same seed (never using the result store), and the
+    /// relative bias of the mean time is reported with its standard error, along with the speedup.
+    void ValidateApprox(std::ostream & os) {
+      os << "#" << config.GetComboHeaders() << ", exact_time, approx_time, bias, bias_stderr"
+         << ", exact_frac_restrain, approx_frac_restrain, speedup" << std::endl;
+      emp::Random mc_random;
+      Multicell mc(mc_random);
+
+      config.ResetCombos();
+      do {
+        const size_t num_runs = config.GetValue<size_t>("data_count");
+        Multicell exact_settings(random), approx_settings(random);
+        exact_settings.CopyConfig(multicell);
+        exact_settings.approx_window = 0.0;
+        approx_settings.CopyConfig(multicell);
+
+        // Sum and sum of squares of times, restrained fractions, and wall time for each mode.
+        double exact_total = 0.0, exact_sq = 0.0, exact_restrained = 0.0, exact_seconds = 0.0;
+        double approx_total = 0.0, approx_sq = 0.0, approx_restrained = 0.0, approx_seconds = 0.0;
+        for (size_t rep_id = 0; rep_id < num_runs; rep_id++) {
+          const int seed = GetReplicateSeed(config.GetComboID(), rep_id);
+          RunResults exact_results, approx_results;
+          {
+            PerfTimer timer(exact_seconds);
+            exact_results = RunReplicate(mc, mc_random, exact_settings, seed);
+          }
+          {
+            PerfTimer timer(approx_seconds);
+            approx_results = RunReplicate(mc, mc_random, approx_settings, seed);
+          }
+          const double exact_time = exact_results.GetReproTime();
+          const double approx_time = approx_results.GetReproTime();
+          exact_total += exact_time;
+          exact_sq += exact_time * exact_time;
+          exact_restrained += exact_results.CountRestrained(multicell.restrain);
+          approx_total += approx_time;
+          approx_sq += approx_time * approx_time;
+          approx_restrained += approx_results.CountRestrained(multicell.restrain);
+        }
+
+        const double exact_mean = exact_total / num_runs;
+        const double approx_mean = approx_total / num_runs;
+        const double exact_var = (exact_sq - num_runs * exact_mean * exact_mean) / (num_runs - 1);
+        const double approx_var = (approx_sq - num_runs * approx_mean * approx_mean) / (num_runs - 1);
+        const double bias = approx_mean / exact_mean - 1.0;
+        const double bias_stderr = std::sqrt((exact_var + approx_var) / num_runs) / exact_mean;
+        const double mc_size = (double) multicell.GetSize() * num_runs;
+        os << config.CurComboString(", ") << ", " << exact_mean << ", " << approx_mean
+           << ", " << bias << ", " << bias_stderr
+           << ", " << exact_restrained / mc_size << ", " << approx_restrained / mc_size
+           << ", " << exact_seconds / approx_seconds << std::endl;
+        std::cout << "Treatment #" << config.GetComboID() << " (" << config.CurComboString(", ", true, true)
+                  << "): bias " << bias * 100.0 << "% +/- " << bias_stderr * 100.0 << "%, speedup "
+                  << exact_seconds / approx_seconds << "x" << std::endl;
+      } while (config.NextCombo());
     }
 
     /// Step through all configurations and collect multicell data for each.
     void RunMulticells(std::ostream & os) {
       // Print column headers.
-      os << "#" << config.GetComboHeaders();
+      std::stringstream header;
+      header << "#" << config.GetComboHeaders();
       if (print_reps) {
         const size_t num_runs = config.GetValue<size_t>("data_count");
-        for (size_t i=0; i < num_runs; i++) os << ", run" << i;
+        for (size_t i=0; i < num_runs; i++) header << ", run" << i;
+      }
+      header << ", ave_time, frac_restrain";
+      if (streaming) header << ", sd_time, median_time, iqr_time, p99_time";
+      if (shard.active) {
+        os << "#shard " << shard.ToString() << " multicell" << std::endl
+           << "#print_reps " << print_reps << std::endl
+           << "#header " << header.str() << std::endl;
       }
-      os << ", ave_time, frac_restrain" << std::endl;
+      else if (!binary_output) os << header.str() << std::endl;
 
-      // Setup the correct collection for the treatments.
+      // Setup the correct collection for the treatments (left empty when streaming).
       base_results.resize(config.CountCombos());
 
+      // Traces and animations only make sense one replicate at a time.
+      const bool watching = print_trace || updates_per_frame != -1;
+      if ((num_threads != 1 || shard.active) && !watching) {
+        RunMulticellsParallel(os);
+        return;
+      }
+
       // Loop through configuration combonations to test.
       config.ResetCombos();
       do {
@@ -551,29 +1538,115 @@
                   << "  " << config.CurComboString(", ", true, true)
                   << std::endl;
 
-        os << config.CurComboString(", ");  // Output current setting combination data.
-
-        RunResults treatment_results = SummarizeTreatment(os);
+        // Time not spent simulating goes to loading or saving stored results.
+        multicell.perf = PerfCounters();
+        double treatment_time = 0.0;
+        StreamingSummary summary;
+        {
+          PerfTimer timer(treatment_time);
+          if (streaming) summary = SummarizeTreatment();
+          else RunTreatment();
+        }
+        multicell.perf.setup_time = treatment_time - multicell.perf.run_time;
 
-        os << ", " << treatment_results.GetReproTime()
-           << ", " << (treatment_results.CountRestrained(multicell.restrain) / (double) multicell.GetSize())
-           << std::endl;
+        {
+          PerfTimer timer(multicell.perf.output_time);
+          if (streaming) {
+            OutputSummary(os, config.GetComboID(), config.CurComboString(", "), summary,
+                          multicell.restrain, multicell.GetSize());
+          }
+          else {
+            OutputTreatment(os, config.GetComboID(), config.CurComboString(", "),
+                            base_results[config.GetComboID()], multicell.restrain, multicell.GetSize());
+          }
+        }
+        ReportPerf(config.GetComboID(), config.CurComboString(", "), multicell.perf);
       } while (config.NextCombo());
     }
 
     void RunEvolution(std::ostream & os) {
+      // Each run has its own seed (see GetReplicateSeed) and each treatment its own sample
+      // cache, so any treatment can be run on its own (but not any run; see EvolveTreatment).
+      if (shard.active) {
+        os << "#shard " << shard.ToString() << " evolution" << std::endl
+           << "#treatments " << config.CountCombos() << std::endl;
+      }
       // Print column headers.
-      os << "#run_id,num_ones,count" << std::endl;
+      else if (!binary_output) os << "#run_id,num_ones,count" << std::endl;
+
       config.ResetCombos();
       do {
+        if (shard.active) {
+          const size_t combo_id = config.GetComboID();
+          if (!shard.Has(combo_id)) continue;
+          os << "#treatment " << combo_id << std::endl;
+        }
         EvolveTreatment(os);
       } while (config.NextCombo());
     }
 
+    /// Predict the mutation-selection balance of every treatment (-B) from the repro-time
+    /// samples of each genotype from -y to -z (see BalancePredictor.h), rather than evolving.
+    /// Samples come from -L if given; missing ones are simulated, as during evolution.
+    void PredictBalance(std::ostream & os) {
+      os << "#" << config.GetComboHeaders() << ", num_ones, frequency" << std::endl;
+      config.ResetCombos();
+      do {
+        if (multicell.mut_prob <= 0.0) {
+          std::cerr << "ERROR: Predicting a balance (-B) requires mutations (-m above zero)." << std::endl;
+          exit(1);
+        }
+        int min_ones = config.GetValue<int>("load_samples_min");
+        int max_ones = config.GetValue<int>("load_samples_max");
+        if (!multicell.is_infinite) {
+          min_ones = std::max(min_ones, 0);
+          max_ones = std::min(max_ones, (int) multicell.genome_size);
+        }
+        if (min_ones > max_ones) {
+          std::cerr << "ERROR: No genotypes between -y " << min_ones << " and -z " << max_ones
+                    << " to predict a balance (-B) over." << std::endl;
+          exit(1);
+        }
+
+        const std::string combo_string = config.CurComboString(", ");  // Before samples change start_1s.
+        Population pop(config.GetValue<size_t>("pop_size"), config.GetValue<int>("ancestor_1s"),
+                       config.GetValue<size_t>("sample_size"), multicell, random, stream_manager,
+                       enforce_data_bounds, result_store);
+        random.ResetSeed(GetReplicateSeed(config.GetComboID(), 0));
+        LoadSamples(pop);
+        emp::vector<emp::vector<double>> samples;
+        for (int num_ones = min_ones; num_ones <= max_ones; num_ones++) {
+          samples.push_back(pop.GetSamples(num_ones));
+        }
+
+        BalancePredictor::Kernel kernel{ multicell.mut_prob, multicell.is_infinite,
+                                         multicell.inf_mut_decrease_prob, multicell.genome_size };
+        const BalancePredictor::Balance balance = BalancePredictor::Solve(samples, min_ones, kernel);
+        for (size_t i = 0; i < balance.freqs.size(); i++) {
+          os << combo_string << ", " << min_ones + (int) i << ", " << balance.freqs[i] << std::endl;
+        }
+        std::cout << "Treatment #" << config.GetComboID() << " (" << config.CurComboString(", ", true, true)
+                  << "): balance at " << balance.CalcAveOnes() << " ones (variance "
+                  << balance.CalcVarOnes() << "), mean repro time " << balance.CalcAveReproTime(samples)
+                  << std::endl;
+        if (balance.CalcEdgeFreq() > 0.001) {
+          std::cout << "WARNING: " << balance.CalcEdgeFreq() * 100.0 << "% of the balance is at the ends of -y "
+                    << min_ones << " to -z " << max_ones << "; widen the range." << std::endl;
+        }
+      } while (config.NextCombo());
+    }
+
     // Run all of the configurations in an entire set.
     void Run() {
       size_t gen_count = config.GetValue<size_t>("gen_count");
       random.ResetSeed(config.GetValue<int>("random_seed"));
+      run_seed = (uint64_t) random.GetSeed();
+      shard = ShardInfo::FromString(config.GetValue<std::string>("shard"));
+      if (shard.active && config.GetValue<int>("random_seed") < 0) {
+        std::cerr << "ERROR: Shards must share a random seed; please set one with -w." << std::endl;
+        exit(1);
+      }
+      result_store.SetDirectory(config.GetValue<std::string>("result_store"));
       std::string evolution_filename = config.GetValue<std::string>("evolution_filename");
       std::string multicell_filename = config.GetValue<std::string>("multicell_filename");
       std::string config_filename = config.GetValue<std::string>("config_filename");
@@ -581,10 +1654,107 @@
       config_os << "#" << config.GetComboHeaders() << std::endl;
       config_os << config.CurComboString(", ") << std::endl;// Output current setting combination 
 
+      // Binary output goes through column writers; a null stream stands in for the text file.
+      binary_output = (config.GetValue<std::string>("output_format") == "binary");
+      if (binary_output && shard.active) {
+        std::cerr << "ERROR: Shards must use text output; merge them first." << std::endl;
+        exit(1);
+      }
+      // Traced or animated multicells run one treatment at a time, outside of any shard.
+      if (shard.active && !gen_count && (print_trace || updates_per_frame != -1)) {
+        std::cerr << "ERROR: Shards (-S) of multicell runs cannot be traced (-T) or animated (-f)." << std::endl;
+        exit(1);
+      }
+      if (multicell.compact && (print_trace || updates_per_frame != -1)) {
+        std::cerr << "ERROR: Compact multicells (-q) cannot be traced or animated." << std::endl;
+        exit(1);
+      }
+      if (multicell.approx_window < 0.0 || multicell.approx_window > 100.0) {
+        std::cerr << "ERROR: Approximate time windows (-A) must be between 0 and 100." << std::endl;
+        exit(1);
+      }
+      if (multicell.approx_window > 0.0 && multicell.compact) {
+        std::cerr << "ERROR: Approximate runs (-A) cannot use compact multicells (-q)." << std::endl;
+        exit(1);
+      }
+      if (streaming && (print_reps || shard.active)) {
+        std::cerr << "ERROR: Streaming summaries (-N) cannot print (-P) or shard (-S) replicates." << std::endl;
+        exit(1);
+      }
+      if ((common_random || antithetic) && config.GetValue<std::string>("result_store").size()) {
+        std::cerr << "ERROR: Stored results (-R) would break the pairing of -V and -W replicates." << std::endl;
+        exit(1);
+      }
+      // The strip (-D) and time-window (-A) engines draw from their own streams, not the shared ones.
+      if ((common_random || antithetic) && (multicell.domain_threads != 1 || multicell.approx_window > 0.0)) {
+        std::cerr << "ERROR: Common random numbers (-V) and antithetic pairs (-W) cannot be combined "
+                  << "with -D or -A." << std::endl;
+        exit(1);
+      }
+      // Only the exact engine has an endgame.
+      if (multicell.endgame_empty && (multicell.compact || multicell.approx_window > 0.0
+                                      || multicell.domain_threads != 1)) {
+        std::cerr << "ERROR: The endgame (-G) cannot be combined with -q, -A or -D." << std::endl;
+        exit(1);
+      }
+      if (log_stride == 0) {
+        std::cerr << "ERROR: The log stride (-O) must be at least one generation." << std::endl;
+        exit(1);
+      }
+      if (adaptive_budget < 0.0 || adaptive_budget > 1.0 || (adaptive_budget > 0.0 && estimate_sizes.size())) {
+        std::cerr << "ERROR: The adaptive sample budget (-H) must be between 0 and 1, and cannot be "
+                  << "combined with estimated samples (-X)." << std::endl;
+        exit(1);
+      }
+      if (balance_predict && (binary_output || shard.active)) {
+        std::cerr << "ERROR: Balance predictions (-B) are written as text, and cannot be sharded (-S)." << std::endl;
+        exit(1);
+      }
+      if (validate_approx && multicell.approx_window == 0.0) {
+        std::cerr << "ERROR: Validating approximate runs (-U) requires a time window (-A)." << std::endl;
+        exit(1);
+      }
+      std::ostream null_os(nullptr);
+      // Building a sample library replaces the normal multicell or evolution run.
+      const std::string build_samples_directory = config.GetValue<std::string>("build_samples");
+      if (build_samples_directory.size()) {
+        const uint64_t base_seed = random.GetUInt(2147483647);
+        if (estimate_sizes.size()) EstimateSampleLibrary(build_samples_directory, base_seed);
+        else if (adaptive_budget > 0.0) AdaptSampleLibrary(build_samples_directory, base_seed);
+        else BuildSampleLibrary(build_samples_directory, base_seed);
+        return;
+      }
+      if (validate_approx) {
+        ValidateApprox(stream_manager.get_ostream(multicell_filename));
+        return;
+      }
+      if (balance_predict) {
+        PredictBalance(stream_manager.get_ostream(evolution_filename));
+        return;
+      }
+
+      if (binary_output) OpenBinaryOutput(gen_count);
+
+      // Performance reports get one row per treatment.
+      const std::string perf_report = config.GetValue<std::string>("perf_report");
+      if (perf_report.size()) {
+        auto & perf_os = stream_manager.get_ostream(perf_report);
+        if (!PerfCounters::ENABLED) {
+          perf_os << "# Event counters are disabled; rebuild with 'make perf' to include them." << std::endl;
+        }
+        perf_os << "#combo_id, " << config.GetComboHeaders() << ", " << PerfCounters::GetHeaders() << std::endl;
+      }
+
       // If we have a generation count, collect evolution data.
-      if (gen_count) RunEvolution(stream_manager.get_ostream(evolution_filename));
+      if (gen_count) {
+        RunEvolution(binary_output ? null_os : stream_manager.get_ostream(evolution_filename));
+      }
       // Otherwise collect information on multicells.
-      else RunMulticells(stream_manager.get_ostream(multicell_filename));
+      else RunMulticells(binary_output ? null_os : stream_manager.get_ostream(multicell_filename));
+
+      if (data_writer) data_writer->Close();
+      if (reps_writer) reps_writer->Close();
+      if (gens_writer) gens_writer->Close();
     }
   };
 
@@ -0,0 +1,142 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  StreamingStats.h
+ *  @brief Constant-memory summaries of replicates, updated as each one finishes (-N).
+ *  @note Status: BETA
+ *
+ *  RunningStats keeps a mean and variance with Welford's update.  P2Quantile estimates a single
+ *  quantile with the P-squared algorithm (Jain & Chlamtac, CACM 1985), which tracks five
+ *  markers whose heights are adjusted with piecewise-parabolic interpolation; it is exact for
+ *  up to five values and typically within a fraction of a percent of the true quantile after a
+ *  few hundred.  Results depend on the order values are added, so replicates are always added
+ *  in order.
+ */
+
+#ifndef STREAMING_STATS_H
+#define STREAMING_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "Multicell.h"
+
+/// Mean and variance of a stream of values, by Welford's method.
+class RunningStats {
+private:
+  size_t count = 0;
+  double mean = 0.0;
+  double m2 = 0.0;    ///< Sum of squared differences from the mean.
+
+public:
+  void Add(double value) {
+    count++;
+    const double delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+  }
+
+  size_t GetCount() const { return count; }
+  double GetMean() const { return mean; }
+  double GetVariance() const { return count > 1 ? m2 / (count - 1) : 0.0; }   ///< Sample variance
+  double GetStdDev() const { return std::sqrt(GetVariance()); }
+};
+
+/// Streaming estimate of the p'th quantile, with the P-squared algorithm.
+class P2Quantile {
+private:
+  double p;
+  size_t count = 0;
+  std::array<double, 5> heights;    ///< Marker heights (the first five values, until full).
+  std::array<double, 5> positions;  ///< Actual marker positions.
+  std::array<double, 5> desired;    ///< Desired marker positions.
+  std::array<double, 5> increments; ///< Change in desired positions per value.
+
+  /// Piecewise-parabolic prediction of marker i's height if moved by dir (+1 or -1).
+  double Parabolic(size_t i, double dir) const {
+    return heights[i] + dir / (positions[i+1] - positions[i-1]) *
+      ((positions[i] - positions[i-1] + dir) * (heights[i+1] - heights[i]) / (positions[i+1] - positions[i]) +
+       (positions[i+1] - positions[i] - dir) * (heights[i] - heights[i-1]) / (positions[i] - positions[i-1]));
+  }
+
+  double Linear(size_t i, int dir) const {
+    return heights[i] + dir * (heights[i+dir] - heights[i]) / (positions[i+dir] - positions[i]);
+  }
+
+public:
+  P2Quantile(double _p) : p(_p) { }
+
+  void Add(double value) {
+    if (count < 5) {              // Collect the first five values exactly.
+      heights[count++] = value;
+      if (count < 5) return;
+      std::sort(heights.begin(), heights.end());
+      positions = { 0, 1, 2, 3, 4 };
+      desired = { 0, 2*p, 4*p, 2+2*p, 4 };
+      increments = { 0, p/2, p, (1+p)/2, 1 };
+      return;
+    }
+    count++;
+
+    // Find the cell the new value falls in, extending the extremes if needed.
+    size_t cell;
+    if (value < heights[0]) { heights[0] = value; cell = 0; }
+    else if (value >= heights[4]) { heights[4] = value; cell = 3; }
+    else { cell = 0; while (value >= heights[cell+1]) cell++; }
+    for (size_t i = cell + 1; i < 5; i++) positions[i] += 1.0;
+    for (size_t i = 0; i < 5; i++) desired[i] += increments[i];
+
+    // Move the middle markers toward their desired positions.
+    for (size_t i = 1; i < 4; i++) {
+      const double offset = desired[i] - positions[i];
+      if ((offset >= 1.0 && positions[i+1] - positions[i] > 1.0) ||
+          (offset <= -1.0 && positions[i-1] - positions[i] < -1.0)) {
+        const int dir = offset > 0.0 ? 1 : -1;
+        const double height = Parabolic(i, dir);
+        if (heights[i-1] < height && height < heights[i+1]) heights[i] = height;
+        else heights[i] = Linear(i, dir);
+        positions[i] += dir;
+      }
+    }
+  }
+
+  /// The current estimate (interpolated exactly while there are five or fewer values).
+  double Get() const {
+    if (count == 0) return 0.0;
+    if (count > 5) return heights[2];
+    std::array<double, 5> sorted = heights;
+    std::sort(sorted.begin(), sorted.begin() + count);
+    const double pos = p * (count - 1);
+    const size_t below = (size_t) pos;
+    if (below + 1 >= count) return sorted[count-1];
+    return sorted[below] + (pos - below) * (sorted[below+1] - sorted[below]);
+  }
+};
+
+/// Everything reported about a treatment's replicates, without keeping them.
+struct StreamingSummary {
+  RunResults total;                 ///< Sum of all replicates, including the genotype histogram.
+  RunningStats time;                ///< Replication times.
+  P2Quantile q25{0.25}, median{0.5}, q75{0.75}, p99{0.99};
+
+  void Add(const RunResults & results) {
+    total += results;
+    const double repro_time = results.GetReproTime();
+    time.Add(repro_time);
+    q25.Add(repro_time);
+    median.Add(repro_time);
+    q75.Add(repro_time);
+    p99.Add(repro_time);
+  }
+
+  /// Average of all replicates, as printed for a stored treatment.
+  RunResults GetAverage() const {
+    RunResults average(total);
+    average /= (double) time.GetCount();
+    return average;
+  }
+};
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  WorkPool.h
+ *  @brief A simple work-stealing thread pool for running many independent jobs.
+ *  @note Status: BETA
+ *
+ *  All jobs are added before the pool is started.  Jobs are dealt round-robin into one queue per
+ *  worker in the order they were added; each worker runs jobs from the front of its own queue and,
+ *  once that is empty, steals from the front of the other queues.  Adding jobs in decreasing order
+ *  of cost therefore starts the biggest jobs first while keeping all workers busy to the end.
+ *
+ *  Jobs are given the id of the worker running them so they can use per-worker resources.
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "emp/base/vector.hpp"
+
+class WorkPool {
+public:
+  using job_t = std::function<void(size_t)>;   ///< Jobs are given the id of their worker.
+
+private:
+  struct WorkQueue {
+    std::deque<job_t> jobs;
+    std::mutex mutex;
+  };
+
+  emp::vector<std::unique_ptr<WorkQueue>> queues;  ///< One queue per worker.
+  emp::vector<std::thread> threads;
+  size_t next_queue = 0;                           ///< Which queue gets the next job added?
+
+  /// Pull the next job from a queue, if there is one.
+  bool PopJob(size_t queue_id, job_t & job) {
+    WorkQueue & queue = *queues[queue_id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+    job = std::move(queue.jobs.front());
+    queue.jobs.pop_front();
+    return true;
+  }
+
+  void RunWorker(size_t worker_id) {
+    job_t job;
+    while (true) {
+      bool found = PopJob(worker_id, job);
+      for (size_t offset = 1; !found && offset < queues.size(); offset++) {
+        found = PopJob((worker_id + offset) % queues.size(), job);
+      }
+      if (!found) return;           // All jobs are added up front, so no jobs left means done.
+      job(worker_id);
+    }
+  }
+
+public:
+  /// Build a pool with the given number of workers (0 = one per hardware thread).
+  WorkPool(size_t num_workers=0) {
+    if (num_workers == 0) num_workers = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < num_workers; i++) queues.push_back(std::make_unique<WorkQueue>());
+  }
+  WorkPool(const WorkPool &) = delete;
+  ~WorkPool() { Wait(); }
+
+  size_t GetNumWorkers() const { return queues.size(); }
+
+  /// Add a job; must be done before Start().
+  void AddJob(job_t job) {
+    emp_assert(threads.size() == 0, "Cannot add jobs to a WorkPool once it has started.");
+    queues[next_queue]->jobs.push_back(std::move(job));
+    next_queue = (next_queue + 1) % queues.size();
+  }
+
+  /// Launch all workers; returns immediately.
+  void Start() {
+    for (size_t i = 0; i < queues.size(); i++) {
+      threads.emplace_back([this, i](){ RunWorker(i); });
+    }
+  }
+
+  /// Block until all jobs are done.
+  void Wait() {
+    for (std::thread & thread : threads) thread.join();
+    threads.resize(0);
+  }
+};
+
+#endif
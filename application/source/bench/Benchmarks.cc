@@ -0,0 +1,264 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  Benchmarks.cc
+ *  @brief Microbenchmarks for the simulation kernels; run with "make bench".
+ *  @note Status: BETA
+ *
+ *  Every benchmark uses a fixed random seed and reports the number of events it timed, along with
+ *  events/s and ns/event.  Results are printed as they finish and written as JSON to the file
+ *  given on the command line (default: bench.json) so runs can be compared over time.
+ *
+ *  Usage: Benchmarks [output.json] [filter]   (only benchmarks whose name contains filter run)
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "../SpatialRestraint.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+struct BenchResult {
+  std::string name;                                      ///< Which kernel?
+  emp::vector<std::pair<std::string, std::string>> params;  ///< Settings used.
+  std::string event;                                     ///< What counts as one event?
+  size_t events = 0;                                     ///< How many events were timed?
+  double seconds = 0.0;                                  ///< Total wall-clock time.
+
+  double GetEventsPerSec() const { return events / seconds; }
+  double GetNsPerEvent() const { return seconds * 1e9 / events; }
+};
+
+class BenchSuite {
+private:
+  emp::vector<BenchResult> results;
+  std::string filter;
+
+  static double SecondsSince(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+  }
+
+  void Record(BenchResult result) {
+    std::cout << std::left << std::setw(24) << result.name;
+    for (auto & [key, value] : result.params) std::cout << " " << key << "=" << value;
+    std::cout << " : " << result.events << " " << result.event << "s in " << result.seconds
+              << " s (" << result.GetNsPerEvent() << " ns/" << result.event << ")" << std::endl;
+    results.push_back(result);
+  }
+
+  /// Configure a multicell with the settings used across most benchmarks.
+  static void SetupMulticell(Multicell & mc, size_t cells_side, size_t neighbors, bool one_check) {
+    mc.cells_side = cells_side;
+    mc.neighbors = neighbors;
+    mc.one_check = one_check;
+    mc.genome_size = 100;
+    mc.restrain = 50;
+    mc.start_1s = 50;
+    mc.mut_prob = 0.2;
+    mc.time_range = 50;
+  }
+
+public:
+  BenchSuite(const std::string & _filter) : filter(_filter) { }
+
+  bool IsActive(const std::string & name) const { return name.find(filter) != std::string::npos; }
+
+  /// Individual Multicell::DoStep() calls, refilling a 64x64 multicell whenever it is full.
+  void BenchDoStep(size_t neighbors, bool one_check, size_t num_steps=2000000) {
+    if (!IsActive("DoStep")) return;
+    emp::Random random(1);
+    Multicell mc(random);
+    SetupMulticell(mc, 64, neighbors, one_check);
+    mc.SetupConfig();
+    mc.InjectCell(mc.MiddlePos());
+
+    bench_clock::duration total(0);
+    size_t steps_done = 0;
+    while (steps_done < num_steps) {
+      const auto start = bench_clock::now();
+      for (; steps_done < num_steps && mc.num_cells < mc.GetSize(); steps_done++) mc.DoStep();
+      total += bench_clock::now() - start;
+      if (mc.num_cells == mc.GetSize()) {   // Refill (untimed).
+        mc.SetupConfig();
+        mc.InjectCell(mc.MiddlePos());
+      }
+    }
+    Record({"Multicell::DoStep",
+            {{"cells_side", "64"}, {"neighbors", std::to_string(neighbors)},
+             {"one_check", one_check ? "1" : "0"}},
+            "step", steps_done, std::chrono::duration<double>(total).count()});
+  }
+
+  /// Complete Multicell::Run() calls, from a single cell until full; events are cells filled.
+  void BenchRun(size_t cells_side, bool morton=false, size_t target_cells=1<<19) {
+    if (!IsActive("Run")) return;
+    emp::Random random(1);
+    Multicell mc(random);
+    SetupMulticell(mc, cells_side, 8, false);
+    mc.morton = morton;
+    const size_t num_runs = std::max<size_t>(1, target_cells / mc.GetSize());
+
+    const auto start = bench_clock::now();
+    for (size_t run = 0; run < num_runs; run++) {
+      mc.SetupConfig();
+      mc.InjectCell(mc.MiddlePos());
+      mc.Run();
+    }
+    Record({"Multicell::Run",
+            {{"cells_side", std::to_string(cells_side)}, {"runs", std::to_string(num_runs)},
+             {"layout", morton ? "morton" : "row_major"}},
+            "cell", num_runs * mc.GetSize(), SecondsSince(start)});
+  }
+
+  /// Multicell::SetupConfig() and the first InjectCell() of a replicate, after a full run.
+  void BenchSetup(size_t cells_side, size_t num_setups=100000) {
+    if (!IsActive("Setup")) return;
+    emp::Random random(1);
+    Multicell mc(random);
+    SetupMulticell(mc, cells_side, 8, false);
+    mc.SetupConfig();
+    mc.InjectCell(mc.MiddlePos());
+    mc.Run();
+
+    const auto start = bench_clock::now();
+    for (size_t i = 0; i < num_setups; i++) {
+      mc.SetupConfig();
+      mc.InjectCell(mc.MiddlePos());
+    }
+    Record({"Multicell::SetupConfig", {{"cells_side", std::to_string(cells_side)}},
+            "setup", num_setups, SecondsSince(start)});
+  }
+
+  /// Population::NextBirth() with every genotype already in the sample cache.
+  void BenchNextBirth(size_t num_births=5000000) {
+    if (!IsActive("NextBirth")) return;
+    emp::Random random(1);
+    Multicell mc(random);
+    SetupMulticell(mc, 32, 8, false);
+    emp::StreamManager stream_manager;
+    ResultStore result_store;
+    const size_t num_samples = 1000;
+    Population pop(200, 50, num_samples, mc, random, stream_manager, false, result_store);
+
+    // Warm the cache with synthetic samples for every reachable genotype.
+    for (int num_ones = 0; num_ones <= (int) mc.genome_size; num_ones++) {
+      emp::vector<double> & samples = pop.repro_cache[num_ones];
+      for (size_t i = 0; i < num_samples; i++) samples.push_back(1000.0 + random.GetDouble(500.0));
+    }
+    pop.repro_cache_min = -1;
+    pop.repro_cache_max = mc.genome_size + 1;
+    for (size_t i = 0; i < pop.orgs.size(); i++) {
+      pop.orgs[i].repro_time = pop.CalcBirthTime(pop.orgs[i].num_ones);
+      pop.org_queue.Insert(i, pop.orgs[i].repro_time);
+    }
+
+    const auto start = bench_clock::now();
+    for (size_t i = 0; i < num_births; i++) pop.NextBirth();
+    Record({"Population::NextBirth", {{"pop_size", "200"}, {"mut_prob", "0.2"}},
+            "birth", num_births, SecondsSince(start)});
+  }
+
+  /// Population::LoadSamplesFromDisk() on a generated library of 101 genotypes.
+  void BenchLoadSamples(size_t num_samples=1000) {
+    if (!IsActive("LoadSamples")) return;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "sr_bench_samples";
+    std::filesystem::create_directories(dir);
+    emp::Random random(1);
+    for (int num_ones = 0; num_ones <= 100; num_ones++) {
+      emp::vector<double> samples(num_samples);
+      for (double & sample : samples) sample = 1000.0 + random.GetDouble(5000.0);
+      const std::string filename = (dir / (std::to_string(num_ones) + ".dat")).string();
+      std::filesystem::remove(filename);
+      SampleLibrary::AppendSamples(filename, samples);
+    }
+
+    Multicell mc(random);
+    SetupMulticell(mc, 32, 8, false);   // No settings.txt, so genotypes are not pooled.
+    emp::StreamManager stream_manager;
+    ResultStore result_store;
+    Population pop(200, 50, num_samples, mc, random, stream_manager, false, result_store);
+    std::stringstream discard;                       // Silence progress messages while timing.
+    std::streambuf * old_buf = std::cout.rdbuf(discard.rdbuf());
+    const auto start = bench_clock::now();
+    pop.LoadSamplesFromDisk(dir.string() + "/", 0, 100);
+    const double seconds = SecondsSince(start);
+    std::cout.rdbuf(old_buf);
+    std::filesystem::remove_all(dir);
+
+    Record({"LoadSamplesFromDisk", {{"genotypes", "101"}, {"samples", std::to_string(num_samples)}},
+            "sample", 101 * num_samples, seconds});
+  }
+
+  /// Multicell::DrawFrame() of a full, mixed multicell into a gif.
+  void BenchDrawFrame(size_t cells_side, size_t num_frames=20) {
+    if (!IsActive("DrawFrame")) return;
+    emp::Random random(1);
+    Multicell mc(random);
+    SetupMulticell(mc, cells_side, 8, false);
+    mc.mut_prob = 1.0;
+    mc.SetupConfig();
+    mc.InjectCell(mc.MiddlePos());
+    mc.Run();
+    mc.buffer.resize(mc.GetSize() * 4, 0);
+
+    const std::string filename = (std::filesystem::temp_directory_path() / "sr_bench.gif").string();
+    GifWriter gif_writer;
+    GifBegin(&gif_writer, filename.c_str(), cells_side, cells_side, mc.delay);
+    const auto start = bench_clock::now();
+    for (size_t frame = 0; frame < num_frames; frame++) mc.DrawFrame(gif_writer);
+    const double seconds = SecondsSince(start);
+    GifEnd(&gif_writer);
+    std::filesystem::remove(filename);
+
+    Record({"Multicell::DrawFrame",
+            {{"cells_side", std::to_string(cells_side)}, {"frames", std::to_string(num_frames)}},
+            "cell", num_frames * mc.GetSize(), seconds});
+  }
+
+  void WriteJSON(std::ostream & os) const {
+    os << std::setprecision(std::numeric_limits<double>::max_digits10);
+    os << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+      const BenchResult & result = results[i];
+      os << "    {\"name\": \"" << result.name << "\", \"params\": {";
+      for (size_t p = 0; p < result.params.size(); p++) {
+        if (p) os << ", ";
+        os << "\"" << result.params[p].first << "\": \"" << result.params[p].second << "\"";
+      }
+      os << "}, \"event\": \"" << result.event << "\""
+         << ", \"events\": " << result.events
+         << ", \"seconds\": " << result.seconds
+         << ", \"events_per_sec\": " << result.GetEventsPerSec()
+         << ", \"ns_per_event\": " << result.GetNsPerEvent() << "}"
+         << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    os << "  ]\n}\n";
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  const std::string out_filename = (argc > 1) ? argv[1] : "bench.json";
+  BenchSuite suite((argc > 2) ? argv[2] : "");
+
+  for (size_t neighbors : {0, 4, 8}) {
+    for (bool one_check : {false, true}) suite.BenchDoStep(neighbors, one_check);
+  }
+  for (size_t cells_side = 8; cells_side <= 512; cells_side *= 2) suite.BenchRun(cells_side);
+  for (size_t cells_side : {256, 512}) suite.BenchRun(cells_side, true);
+  for (size_t cells_side : {8, 64, 512}) suite.BenchSetup(cells_side);
+  suite.BenchNextBirth();
+  suite.BenchLoadSamples();
+  for (size_t cells_side : {64, 256}) suite.BenchDrawFrame(cells_side);
+
+  std::ofstream out_file(out_filename);
+  suite.WriteJSON(out_file);
+  std::cout << "Results written to " << out_filename << std::endl;
+}
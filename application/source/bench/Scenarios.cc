@@ -0,0 +1,313 @@
+/**
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  Scenarios.cc
+ *  @brief End-to-end scenarios with fixed seeds, checked against a baseline; run with "make scenarios".
+ *  @note Status: BETA
+ *
+ *  Each scenario is a full command line, modeled on the runs in experiments/ (multicells from
+ *  8 to 512 cells on a side, finite and infinite genomes, one_check on and off, evolution with
+ *  and without a sample library from -L).  Every scenario runs in its own child process, in a
+ *  scratch directory, so that wall time, peak RSS and the output files are its own.  The output
+ *  data files are checksummed; any change in a checksum means results changed.
+ *
+ *  Results are written as JSON.  Given a baseline (a previous output, saved with --save), each
+ *  scenario is compared against it: a changed checksum, or wall time or peak RSS beyond their
+ *  tolerances, is a regression, and the exit status is nonzero.  Unless filtered, consistency
+ *  checks between output modes (see RunConsistencyChecks) also run, and count as regressions.
+ *
+ *  Usage: Scenarios [output.json] [baseline.json] [--save] [--filter=NAME]
+ *                   [--repeat=N] [--time_tol=FRAC] [--rss_tol=FRAC]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "emp/tools/string_utils.hpp"
+
+#include "../SpatialRestraint.h"
+
+using scenario_clock = std::chrono::steady_clock;
+
+struct Scenario {
+  std::string name;                     ///< Unique name, for comparing against baselines.
+  std::string setup;                    ///< Untimed command line to run first (if any).
+  std::string args;                     ///< Timed command line.
+  std::string event;                    ///< What counts as one event?
+  size_t events;                        ///< How many events does the timed run perform?
+};
+
+struct ScenarioResult {
+  std::string name;
+  std::string event;
+  size_t events = 0;
+  double seconds = 0.0;                 ///< Wall-clock time (fastest of all repeats).
+  long peak_rss_kb = 0;                 ///< Peak resident set size of the timed run.
+  std::string checksum;                 ///< FNV-1a of all output data files.
+
+  double GetEventsPerSec() const { return events / seconds; }
+};
+
+/// The pinned set of scenarios.  Changing any of these invalidates saved baselines.
+static emp::vector<Scenario> GetScenarios() {
+  const std::string lib_settings = "-c 32 -a 60 -r 60 -m 0.02 -s 50 -w 11";
+  return {
+    {"multicell_small_finite", "",
+     "-c 8,16,32,64 -d 50 -a 60 -r 60 -m 0.5 -w 1", "cell", 50 * (64 + 256 + 1024 + 4096)},
+    {"multicell_small_finite_one_check", "",
+     "-c 8,16,32,64 -d 50 -a 60 -r 60 -m 0.5 -o -w 2", "cell", 50 * (64 + 256 + 1024 + 4096)},
+    {"multicell_small_infinite", "",
+     "-c 8,16,32,64 -d 50 -a 60 -r 60 -m 0.5 -I -w 3", "cell", 50 * (64 + 256 + 1024 + 4096)},
+    {"multicell_256", "", "-c 256 -d 4 -a 60 -r 60 -m 0.02 -w 4", "cell", 4 * 65536},
+    {"multicell_256_one_check", "", "-c 256 -d 1 -a 60 -r 60 -m 0.02 -o -w 5", "cell", 65536},
+    {"multicell_512", "", "-c 512 -d 1 -a 60 -r 60 -m 0.02 -w 6", "cell", 262144},
+    {"evolution", "", "-g 200 -p 100 -d 2 " + lib_settings, "birth", 2 * 200 * 100},
+    {"evolution_load_samples", "-l lib -y 50 -z 70 " + lib_settings,
+     "-g 1000 -p 100 -d 2 -L lib/thresh__60/cell_mut__0.02/mcsize__32/ -y 50 -z 70 " + lib_settings,
+     "birth", 2 * 1000 * 100},
+  };
+}
+
+/// FNV-1a hash of a file's contents, folded into hash.
+static uint64_t HashFile(const std::string & filename, uint64_t hash) {
+  std::ifstream in(filename, std::ios::binary);
+  char c;
+  while (in.get(c)) {
+    hash ^= (unsigned char) c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/// Run a command line in a child process (with output silenced); returns its peak RSS in kB.
+static long RunChild(const std::string & args, const std::filesystem::path & dir) {
+  std::cout.flush();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    std::filesystem::current_path(dir);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    emp::vector<std::string> argv{"SpatialRestraint"};
+    for (const std::string & arg : emp::slice(args, ' ')) if (arg.size()) argv.push_back(arg);
+    Experiment experiment(argv);
+    experiment.Run();
+    std::cout.flush();
+    _exit(0);
+  }
+  int status = 0;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::cerr << "ERROR: Scenario command failed: " << args << std::endl;
+    exit(1);
+  }
+  return usage.ru_maxrss;
+}
+
+static ScenarioResult RunScenario(const Scenario & scenario, size_t repeats) {
+  ScenarioResult result{scenario.name, scenario.event, scenario.events};
+  for (size_t rep = 0; rep < repeats; rep++) {
+    const std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / ("sr_scenario_" + std::to_string(getpid()));
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    if (scenario.setup.size()) RunChild(scenario.setup, dir);
+
+    const auto start = scenario_clock::now();
+    const long peak_rss_kb = RunChild(scenario.args + " -M out_multicell.dat -E out_evolution.dat", dir);
+    const double seconds = std::chrono::duration<double>(scenario_clock::now() - start).count();
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char * filename : {"out_multicell.dat", "out_evolution.dat"}) {
+      hash = HashFile((dir / filename).string(), hash);
+    }
+    std::stringstream checksum;
+    checksum << std::hex << std::setw(16) << std::setfill('0') << hash;
+    std::filesystem::remove_all(dir);
+
+    if (rep == 0 || seconds < result.seconds) result.seconds = seconds;
+    result.peak_rss_kb = std::max(result.peak_rss_kb, peak_rss_kb);
+    if (rep > 0 && checksum.str() != result.checksum) {
+      std::cerr << "ERROR: Scenario " << scenario.name << " is not deterministic." << std::endl;
+      exit(1);
+    }
+    result.checksum = checksum.str();
+  }
+  return result;
+}
+
+static void WriteJSON(std::ostream & os, const emp::vector<ScenarioResult> & results) {
+  os << std::setprecision(std::numeric_limits<double>::max_digits10);
+  os << "{\n  \"scenarios\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const ScenarioResult & result = results[i];
+    os << "    {\"name\": \"" << result.name << "\", \"event\": \"" << result.event << "\""
+       << ", \"events\": " << result.events
+       << ", \"seconds\": " << result.seconds
+       << ", \"events_per_sec\": " << result.GetEventsPerSec()
+       << ", \"peak_rss_kb\": " << result.peak_rss_kb
+       << ", \"checksum\": \"" << result.checksum << "\"}"
+       << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  os << "  ]\n}\n";
+}
+
+/// Find the value for key in a single-line JSON object, as written by WriteJSON.
+static std::string GetJSONValue(const std::string & line, const std::string & key) {
+  const std::string pattern = "\"" + key + "\": ";
+  size_t start = line.find(pattern);
+  if (start == std::string::npos) return "";
+  start += pattern.size();
+  if (line[start] == '"') return line.substr(start + 1, line.find('"', start + 1) - start - 1);
+  return line.substr(start, line.find_first_of(",}", start) - start);
+}
+
+/// Load the results in a baseline file written by WriteJSON.
+static emp::vector<ScenarioResult> LoadBaseline(const std::string & filename) {
+  emp::vector<ScenarioResult> results;
+  std::ifstream in(filename);
+  std::string line;
+  while (std::getline(in, line)) {
+    const std::string name = GetJSONValue(line, "name");
+    if (name.empty()) continue;
+    ScenarioResult result;
+    result.name = name;
+    result.seconds = std::stod(GetJSONValue(line, "seconds"));
+    result.peak_rss_kb = std::stol(GetJSONValue(line, "peak_rss_kb"));
+    result.checksum = GetJSONValue(line, "checksum");
+    results.push_back(result);
+  }
+  return results;
+}
+
+/// Values of the first data row of a text output file, by column name from its "#" header.
+static std::map<std::string, double> ReadFirstRow(const std::string & filename) {
+  std::ifstream in(filename);
+  std::string header, row;
+  std::getline(in, header);
+  std::getline(in, row);
+  const auto names = emp::slice(header.substr(1), ',');
+  const auto values = emp::slice(row, ',');
+  std::map<std::string, double> result;
+  for (size_t i = 0; i < names.size() && i < values.size(); i++) {
+    std::string name = names[i];
+    name.erase(0, name.find_first_not_of(' '));
+    result[name.substr(0, name.find_last_not_of(' ') + 1)] = std::stod(values[i]);
+  }
+  return result;
+}
+
+/// Checks that different output modes agree on the same replicates; returns how many failed.
+/// Streamed summaries (-N) must report the mean of the replicates printed with -P, including
+/// unrestrained costs (-u).
+static size_t RunConsistencyChecks() {
+  const std::string settings = "-c 16 -d 20 -a 40 -r 60 -m 0.05 -u 1 -w 9";   // Unrestrained.
+  const std::filesystem::path dir =
+    std::filesystem::temp_directory_path() / ("sr_check_" + std::to_string(getpid()));
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  RunChild(settings + " -P -M reps.dat", dir);
+  RunChild(settings + " -N -M streamed.dat", dir);
+  const auto reps = ReadFirstRow((dir / "reps.dat").string());
+  const auto streamed = ReadFirstRow((dir / "streamed.dat").string());
+  std::filesystem::remove_all(dir);
+
+  double total = 0.0;
+  size_t num_reps = 0;
+  for (const auto & [name, value] : reps) {
+    if (name.rfind("run", 0) == 0) { total += value; num_reps++; }
+  }
+  const double rep_mean = total / num_reps;
+  size_t num_failed = 0;
+  for (const auto & [label, ave_time] : { std::make_pair("-P", reps.at("ave_time")),
+                                          std::make_pair("-N", streamed.at("ave_time")) }) {
+    const bool ok = std::abs(ave_time / rep_mean - 1.0) < 1e-5;   // Outputs are rounded to 6 digits.
+    std::cout << std::left << std::setw(34) << (std::string("check_ave_time") + label) << std::right
+              << std::setprecision(2) << " ave_time " << ave_time << " vs replicate mean " << rep_mean
+              << (ok ? "" : "  MISMATCH") << std::endl;
+    if (!ok) num_failed++;
+  }
+  return num_failed;
+}
+
+int main(int argc, char* argv[])
+{
+  std::string out_filename = "scenarios.json";
+  std::string baseline_filename;
+  std::string filter;
+  bool save = false;
+  size_t repeats = 1;
+  double time_tol = 0.10;           // Allowed slowdown (fraction of baseline wall time).
+  double rss_tol = 0.20;            // Allowed growth in peak RSS (fraction of baseline).
+  size_t num_positional = 0;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--save") save = true;
+    else if (arg.rfind("--filter=", 0) == 0) filter = arg.substr(9);
+    else if (arg.rfind("--repeat=", 0) == 0) repeats = std::max(1, std::stoi(arg.substr(9)));
+    else if (arg.rfind("--time_tol=", 0) == 0) time_tol = std::stod(arg.substr(11));
+    else if (arg.rfind("--rss_tol=", 0) == 0) rss_tol = std::stod(arg.substr(10));
+    else if (num_positional == 0) { out_filename = arg; num_positional++; }
+    else if (num_positional == 1) { baseline_filename = arg; num_positional++; }
+    else {
+      std::cerr << "ERROR: Unknown argument " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  emp::vector<ScenarioResult> baseline;
+  if (!save && baseline_filename.size() && std::filesystem::exists(baseline_filename)) {
+    baseline = LoadBaseline(baseline_filename);
+  }
+
+  emp::vector<ScenarioResult> results;
+  size_t num_regressions = 0;
+  for (const Scenario & scenario : GetScenarios()) {
+    if (scenario.name.find(filter) == std::string::npos) continue;
+    const ScenarioResult result = RunScenario(scenario, repeats);
+    results.push_back(result);
+    std::cout << std::left << std::setw(34) << result.name << std::right
+              << std::fixed << std::setprecision(3) << std::setw(9) << result.seconds << " s "
+              << std::setprecision(0) << std::setw(12) << result.GetEventsPerSec() << " "
+              << result.event << "s/s " << std::setw(9) << result.peak_rss_kb << " kB  "
+              << result.checksum;
+
+    for (const ScenarioResult & base : baseline) {
+      if (base.name != result.name) continue;
+      const double time_ratio = result.seconds / base.seconds;
+      const double rss_ratio = (double) result.peak_rss_kb / base.peak_rss_kb;
+      std::cout << std::setprecision(2) << "  time x" << time_ratio << "  rss x" << rss_ratio;
+      if (result.checksum != base.checksum) { std::cout << "  RESULTS CHANGED"; num_regressions++; }
+      if (time_ratio > 1.0 + time_tol) { std::cout << "  SLOWER"; num_regressions++; }
+      if (rss_ratio > 1.0 + rss_tol) { std::cout << "  MORE MEMORY"; num_regressions++; }
+    }
+    std::cout << std::endl;
+  }
+
+  if (filter.empty()) num_regressions += RunConsistencyChecks();
+
+  std::ofstream out_file(out_filename);
+  WriteJSON(out_file, results);
+  std::cout << "Results written to " << out_filename << std::endl;
+  if (save && baseline_filename.size()) {
+    std::ofstream baseline_file(baseline_filename);
+    WriteJSON(baseline_file, results);
+    std::cout << "Baseline saved to " << baseline_filename << std::endl;
+  }
+  else if (baseline.size()) {
+    std::cout << num_regressions << " regression(s) against " << baseline_filename << std::endl;
+  }
+  return num_regressions ? 1 : 0;
+}
@@ -0,0 +1,264 @@
+/*
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  SpatialRestraint-capi.cc
+ *  @brief The C interface (SpatialRestraint-capi.h), built into a shared library with "make capi".
+ *  @note Status: BETA
+ *
+ *  Each handle owns the simulation objects it drives and the arrays it hands out, so callers
+ *  (e.g. numpy, through experiments/scripts/spatial_restraint.py) can wrap those arrays in
+ *  place rather than copying them.
+ */
+
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <string>
+
+// Local
+#include "../SpatialRestraint.h"
+#include "SpatialRestraint-capi.h"
+
+struct sr_multicell {
+  emp::Random random;
+  Multicell multicell;
+  size_t num_threads = 1;   ///< Replicates to run at once (0 = all hardware threads).
+
+  sr_multicell() : multicell(random) { }
+};
+
+struct sr_results {
+  emp::vector<double> fill_times;
+  emp::vector<double> repro_times;
+  emp::vector<double> histogram;   ///< Row-major: replicates x (max_ones - min_ones + 1)
+  int min_ones = 0;
+  size_t num_ones = 0;
+
+  explicit sr_results(const emp::vector<RunResults> & reps) {
+    int max_ones = 0;
+    bool found = false;
+    for (const RunResults & rep : reps) {
+      fill_times.push_back(rep.run_time);
+      repro_times.push_back(rep.GetReproTime());
+      for (const auto & [ones, count] : rep.cell_counts) {
+        min_ones = found ? std::min(min_ones, ones) : ones;
+        max_ones = found ? std::max(max_ones, ones) : ones;
+        found = true;
+      }
+    }
+    num_ones = found ? (size_t) (max_ones - min_ones + 1) : 0;
+    histogram.resize(reps.size() * num_ones, 0.0);
+    for (size_t rep_id = 0; rep_id < reps.size(); rep_id++) {
+      for (const auto & [ones, count] : reps[rep_id].cell_counts) {
+        histogram[rep_id * num_ones + (size_t) (ones - min_ones)] = count;
+      }
+    }
+  }
+};
+
+struct sr_population {
+  emp::Random random;
+  Multicell multicell;
+  emp::StreamManager stream_manager;
+  ResultStore result_store;
+  Population pop;
+  size_t pop_size;
+  int ancestor_1s;
+
+  sr_population(const Multicell & settings, size_t _pop_size, int _ancestor_1s, size_t num_samples)
+    : multicell(random)
+    , pop(_pop_size, _ancestor_1s, num_samples, multicell, random, stream_manager, false, result_store)
+    , pop_size(_pop_size), ancestor_1s(_ancestor_1s)
+  {
+    multicell.CopyConfig(settings);
+    pop.sample_classes = multicell.GetSampleClasses();   // The population was built before the settings.
+  }
+};
+
+struct sr_trace {
+  emp::vector<double> data;        ///< Rows of Population::LOG_COLUMNS values.
+  emp::vector<int> final_ones;
+};
+
+struct sr_experiment {
+  Experiment experiment;
+
+  explicit sr_experiment(emp::vector<std::string> & args) : experiment(args) { }
+};
+
+namespace {
+
+  /// Settings that can be reached by name, with how to read and write them.
+  double * FindDouble(Multicell & mc, const std::string & name) {
+    if (name == "unrestrained_cost") return &mc.unrestrained_cost;
+    if (name == "mut_prob") return &mc.mut_prob;
+    if (name == "inf_mut_decrease_prob") return &mc.inf_mut_decrease_prob;
+    if (name == "approx_window") return &mc.approx_window;
+    return nullptr;
+  }
+
+  size_t * FindSize(sr_multicell & handle, const std::string & name) {
+    Multicell & mc = handle.multicell;
+    if (name == "time_range") return &mc.time_range;
+    if (name == "neighbors") return &mc.neighbors;
+    if (name == "bit_size") return &mc.genome_size;
+    if (name == "cells_side") return &mc.cells_side;
+    if (name == "domain_threads") return &mc.domain_threads;
+    if (name == "endgame_empty") return &mc.endgame_empty;
+    if (name == "threads") return &handle.num_threads;
+    return nullptr;
+  }
+
+  int * FindInt(Multicell & mc, const std::string & name) {
+    if (name == "ancestor_1s") return &mc.start_1s;
+    if (name == "restrain") return &mc.restrain;
+    return nullptr;
+  }
+
+  bool * FindBool(Multicell & mc, const std::string & name) {
+    if (name == "one_check") return &mc.one_check;
+    if (name == "is_infinite") return &mc.is_infinite;
+    if (name == "compact") return &mc.compact;
+    if (name == "morton") return &mc.morton;
+    return nullptr;
+  }
+
+  /// Seed that replicate seeds are keyed by, as Experiment::Run() finds it (-1 seeds randomly).
+  uint64_t CalcRunSeed(int seed) {
+    emp::Random random(seed);
+    return (uint64_t) random.GetSeed();
+  }
+
+}
+
+extern "C" {
+
+  int sr_api_version(void) { return SR_API_VERSION; }
+
+  sr_multicell * sr_multicell_create(void) {
+    // Take the executable's defaults from a default experiment.
+    emp::vector<std::string> args{ "SpatialRestraint" };
+    Experiment defaults(args);
+    defaults.config.ResetCombos();
+    sr_multicell * mc = new sr_multicell;
+    mc->multicell.CopyConfig(defaults.multicell);
+    mc->num_threads = defaults.num_threads;
+    return mc;
+  }
+
+  void sr_multicell_destroy(sr_multicell * mc) { delete mc; }
+
+  int sr_multicell_set(sr_multicell * mc, const char * name, double value) {
+    if (double * setting = FindDouble(mc->multicell, name)) *setting = value;
+    else if (size_t * setting = FindSize(*mc, name)) *setting = (size_t) value;
+    else if (int * setting = FindInt(mc->multicell, name)) *setting = (int) value;
+    else if (bool * setting = FindBool(mc->multicell, name)) *setting = (value != 0.0);
+    else return -1;
+    return 0;
+  }
+
+  double sr_multicell_get(const sr_multicell * mc, const char * name) {
+    sr_multicell & handle = const_cast<sr_multicell &>(*mc);   // Only read through.
+    if (double * setting = FindDouble(handle.multicell, name)) return *setting;
+    if (size_t * setting = FindSize(handle, name)) return (double) *setting;
+    if (int * setting = FindInt(handle.multicell, name)) return *setting;
+    if (bool * setting = FindBool(handle.multicell, name)) return *setting;
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  sr_results * sr_multicell_run(sr_multicell * mc, size_t num_reps, int seed) {
+    const size_t side = mc->multicell.cells_side;
+    if (side == 0 || (side & (side - 1)) != 0) return nullptr;
+    const Multicell & settings = mc->multicell;   // Only the exact engine has an endgame.
+    if (settings.endgame_empty && (settings.compact || settings.approx_window > 0.0
+                                   || settings.domain_threads != 1)) return nullptr;
+
+    // Replicates are seeded as treatment 0 of the executable's run with this seed.
+    const uint64_t run_seed = CalcRunSeed(seed);
+    emp::vector<RunResults> reps(num_reps);
+    {
+      WorkPool pool(mc->num_threads);
+      emp::vector<emp::Random> worker_randoms(pool.GetNumWorkers());
+      emp::vector<Multicell> worker_multicells;
+      for (emp::Random & worker_random : worker_randoms) worker_multicells.emplace_back(worker_random);
+      for (size_t rep_id = 0; rep_id < num_reps; rep_id++) {
+        pool.AddJob([&, rep_id](size_t worker_id){
+          reps[rep_id] = Experiment::RunReplicate(worker_multicells[worker_id], worker_randoms[worker_id],
+                                                  mc->multicell, CounterRNG::CalcReplicateSeed(run_seed, 0, rep_id));
+        });
+      }
+      pool.Start();
+      pool.Wait();
+    }
+    return new sr_results(reps);
+  }
+
+  void sr_results_destroy(sr_results * results) { delete results; }
+  size_t sr_results_num_reps(const sr_results * results) { return results->fill_times.size(); }
+  const double * sr_results_fill_times(const sr_results * results) { return results->fill_times.data(); }
+  const double * sr_results_repro_times(const sr_results * results) { return results->repro_times.data(); }
+
+  const double * sr_results_histogram(const sr_results * results, int * min_ones, size_t * num_ones) {
+    if (min_ones) *min_ones = results->min_ones;
+    if (num_ones) *num_ones = results->num_ones;
+    return results->histogram.data();
+  }
+
+  sr_population * sr_population_create(const sr_multicell * settings, size_t pop_size,
+                                       int ancestor_1s, size_t num_samples) {
+    return new sr_population(settings->multicell, pop_size, ancestor_1s, num_samples);
+  }
+
+  void sr_population_destroy(sr_population * pop) { delete pop; }
+
+  int sr_population_load_samples(sr_population * pop, const char * directory, int min_ones, int max_ones) {
+    std::string samples_directory(directory);
+    if (!std::filesystem::is_directory(samples_directory)) return -1;
+    if (samples_directory.back() != '/') samples_directory += '/';   // Files are appended directly.
+    pop->pop.LoadSamplesFromDisk(samples_directory, min_ones, max_ones);
+    return 0;
+  }
+
+  sr_trace * sr_population_evolve(sr_population * pop, double num_gens, size_t log_stride,
+                                  int seed, size_t run_id) {
+    sr_trace * trace = new sr_trace;
+    Population & population = pop->pop;
+    pop->random.ResetSeed(CounterRNG::CalcReplicateSeed(CalcRunSeed(seed), 0, run_id));
+    population.Reset(pop->pop_size, pop->ancestor_1s, false);
+    population.log_stride = std::max<size_t>(log_stride, 1);
+    population.gens_trace = log_stride ? &trace->data : nullptr;
+    population.Run(num_gens);
+    population.gens_trace = nullptr;
+    for (const Organism & org : population.orgs) trace->final_ones.push_back(org.num_ones);
+    return trace;
+  }
+
+  void sr_trace_destroy(sr_trace * trace) { delete trace; }
+  size_t sr_trace_num_rows(const sr_trace * trace) { return trace->data.size() / Population::LOG_COLUMNS; }
+  const double * sr_trace_data(const sr_trace * trace) { return trace->data.data(); }
+
+  const int * sr_trace_final_ones(const sr_trace * trace, size_t * num_orgs) {
+    if (num_orgs) *num_orgs = trace->final_ones.size();
+    return trace->final_ones.data();
+  }
+
+  sr_experiment * sr_experiment_create(int argc, const char * const * argv) {
+    emp::vector<std::string> args(argv, argv + argc);
+    return new sr_experiment(args);
+  }
+
+  void sr_experiment_destroy(sr_experiment * experiment) { delete experiment; }
+  void sr_experiment_run(sr_experiment * experiment) { experiment->experiment.Run(); }
+
+  size_t sr_experiment_num_treatments(const sr_experiment * experiment) {
+    return const_cast<sr_experiment *>(experiment)->experiment.config.CountCombos();
+  }
+
+  sr_results * sr_experiment_results(const sr_experiment * experiment, size_t combo_id) {
+    const auto & base_results = experiment->experiment.base_results;
+    if (combo_id >= base_results.size()) return new sr_results({});
+    return new sr_results(base_results[combo_id]);
+  }
+
+}
@@ -0,0 +1,108 @@
+/*
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  SpatialRestraint-capi.h
+ *  @brief C interface to the simulation, built as a shared library with "make capi".
+ *  @note Status: BETA
+ *
+ *  Lets other programs (e.g. experiments/scripts/spatial_restraint.py) configure and run
+ *  multicells, evolving populations and whole experiments in-process, and read their results
+ *  straight from memory instead of parsing output files.
+ *
+ *  All objects are opaque handles; each *_create() or run call that returns one must be
+ *  matched by its *_destroy().  Result arrays belong to their results handle and stay valid
+ *  (and unchanged) until it is destroyed.  Calls with arguments that can be checked up front
+ *  (unknown setting names, a cells_side that is not a power of two, an endgame_empty with
+ *  compact, approx_window or domain_threads) return NULL or -1;
+ *  anything else behaves as in the executable, which prints an error and exits.  Handles may
+ *  be used from any thread, but only one call at a time per handle.
+ *
+ *  Seeds and replicates match the executable: replicate i of a run with seed S gets the same
+ *  results as replicate i of "SpatialRestraint -w S" with the same settings.
+ */
+
+#ifndef SPATIAL_RESTRAINT_CAPI_H
+#define SPATIAL_RESTRAINT_CAPI_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented whenever a function's signature or meaning changes. */
+#define SR_API_VERSION 1
+
+/* Columns of each row in an evolution trace. */
+#define SR_TRACE_COLUMNS 6   /* generation, ave_ones, ave_repro_time, min_ones, max_ones, var_ones */
+
+typedef struct sr_multicell sr_multicell;
+typedef struct sr_results sr_results;
+typedef struct sr_population sr_population;
+typedef struct sr_trace sr_trace;
+typedef struct sr_experiment sr_experiment;
+
+/* Version of the library actually loaded (compare with SR_API_VERSION). */
+int sr_api_version(void);
+
+/* ---- Multicells ----
+ * Settings use the executable's long option names: ancestor_1s, unrestrained_cost, mut_prob,
+ * time_range, neighbors, restrain, bit_size, cells_side, inf_mut_decrease_prob, one_check,
+ * is_infinite, compact, morton, domain_threads, endgame_empty, approx_window, plus threads
+ * (how many replicates to run at once; 0 = all hardware threads).  Defaults are the
+ * executable's; flags are 0 or 1. */
+sr_multicell * sr_multicell_create(void);
+void sr_multicell_destroy(sr_multicell * mc);
+int sr_multicell_set(sr_multicell * mc, const char * name, double value);   /* 0, or -1 if unknown */
+double sr_multicell_get(const sr_multicell * mc, const char * name);        /* NaN if unknown */
+
+/* Run replicates 0 to num_reps-1 (a seed of -1 seeds randomly); NULL if settings are invalid. */
+sr_results * sr_multicell_run(sr_multicell * mc, size_t num_reps, int seed);
+
+/* ---- Multicell results ---- */
+void sr_results_destroy(sr_results * results);
+size_t sr_results_num_reps(const sr_results * results);
+const double * sr_results_fill_times(const sr_results * results);    /* Time to fill, per replicate */
+const double * sr_results_repro_times(const sr_results * results);   /* Plus unrestrained costs */
+/* Cells with each number of ones: num_reps rows of *num_ones counts, for min_ones and up. */
+const double * sr_results_histogram(const sr_results * results, int * min_ones, size_t * num_ones);
+
+/* ---- Evolving populations ----
+ * A population of multicells with the given settings (copied when created).  Its cache of
+ * multicell samples is kept across evolve calls, as across runs in the executable. */
+sr_population * sr_population_create(const sr_multicell * settings, size_t pop_size,
+                                     int ancestor_1s, size_t num_samples);
+void sr_population_destroy(sr_population * pop);
+/* Load samples from a library directory (as -L does); -1 if it does not exist. */
+int sr_population_load_samples(sr_population * pop, const char * directory, int min_ones, int max_ones);
+/* Evolve run run_id of a seed from the ancestor for num_gens generations, recording every
+ * log_stride generations (as -v -O would).  Recording draws from the run's random stream,
+ * so the stride changes trajectories exactly as it does in the executable.  Samples simulated
+ * along the way stay in the cache for later calls, so a run also depends on earlier ones:
+ * evolving runs 0 to run_id of a seed in order on one population matches the executable's
+ * runs, and evolving a single run on a new population matches it with -i. */
+sr_trace * sr_population_evolve(sr_population * pop, double num_gens, size_t log_stride,
+                                int seed, size_t run_id);
+
+/* ---- Evolution traces ---- */
+void sr_trace_destroy(sr_trace * trace);
+size_t sr_trace_num_rows(const sr_trace * trace);
+const double * sr_trace_data(const sr_trace * trace);   /* num_rows rows of SR_TRACE_COLUMNS */
+const int * sr_trace_final_ones(const sr_trace * trace, size_t * num_orgs);   /* Ones in each org */
+
+/* ---- Whole experiments ----
+ * Exactly as the executable would run with these arguments (argv[0] is the program name),
+ * writing the same output files. */
+sr_experiment * sr_experiment_create(int argc, const char * const * argv);
+void sr_experiment_destroy(sr_experiment * experiment);
+void sr_experiment_run(sr_experiment * experiment);
+size_t sr_experiment_num_treatments(const sr_experiment * experiment);
+/* Replicates kept for a treatment of a multicell run (none for evolution or -N). */
+sr_results * sr_experiment_results(const sr_experiment * experiment, size_t combo_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -15,11 +15,14 @@
 
 #include "emp/config/command_line.hpp"
 
+#include "../Batch.h"
 #include "../SpatialRestraint.h"
 
 int main(int argc, char* argv[])
 {
   emp::vector<std::string> args = emp::cl::args_to_strings(argc, argv);
+  if (args.size() > 1 && args[1] == "merge") return MergeShards(args);
+  if (args.size() > 1 && args[1] == "batch") return RunBatch(args);
   Experiment experiment(args);
   experiment.Run();
 }
@@ -5,17 +5,19 @@
  *  @file  SpatialRestraint-web.cc
  *  @brief Web app to show the growth of a multicell under different conditions
  *  @note Status: BETA
+ *
+ *  The simulation runs in a web worker (web/sr-worker.js, around SpatialRestraint-worker.cc),
+ *  which advances the multicell for a time budget per frame and sends back its RGBA pixel
+ *  buffer; each frame is then drawn with a single putImageData, scaled up to the canvas.
  */
 
 
 // TODO: Make colorblind friendly
 // TODO: Add a description of what's going on
 // TODO: Add color key
-// TODO: Look into making updates faster!
-  // If unrestrained cells are present, we may be redrawing the same cell many times
-    // But is this slower than redrawing all cells every time? 
 
 // Standard
+#include <emscripten.h>
 
 // Empirical
 #include "emp/web/web.hpp"
@@ -23,18 +25,13 @@
 #include "emp/web/color_map.hpp"
 #include "emp/web/Element.hpp"
 
-// Local
-#include "../SpatialRestraint.h"
-
 class RogueCellAnimationController: public emp::web::Animate{
 private:
   emp::web::Document doc;                   // Div that all our elements fall in
   const int canvas_width = 512;             // Width in pixels
   const int canvas_height = 512;            // Height in pixels
   int mc_size = 128;                        // Number of cells on one side of the multicell
-  int tile_width = canvas_width / mc_size;  // Width of each cell in pixels
-  int tile_height = canvas_height / mc_size;// Height of each cell in pixels
-  int steps_per_draw = 1024;                // How many cell births per canvas update?
+  double frame_budget_ms = 12.0;            // Simulation time (ms) in the worker per frame
   size_t starting_ones = 55;                // The number of ones in the starting cell's genome
   double mut_prob = 0.2;                    // Per genome mutation rate (only ever one bit flip)
   bool one_check = false;                   // If true, restrained cells only check one random 
@@ -42,103 +39,75 @@ private:
                                             //    restrained cells select randomly from empty 
                                             //    neighbors
   bool run_to_end = false;                  // Do we render multiple updates or only the very end?
-  Multicell multicell;                      // The multicell to be visualized
-  emp::Random random;                       // Random number generator
-  emp::vector<size_t> cells_to_draw;        // List of cell ids to be rendered
-  size_t cells_to_draw_count;               // How many cells have been placed / need rendered?
 
 protected:
-  // Takes the index of a cell in the multicell, and draws it to the canvas
-  void DrawCell(size_t cell_id){
-    auto canvas = doc.Canvas("canvas");
-    size_t num_ones = multicell.cells[cell_id].num_ones;
-    std::string color_fill = "#ffffff";
-    if(num_ones < 50){ // Unrestrained
-        color_fill = emp::ColorRGB(
-          255 - (49 - num_ones) * 5,
-          0,
-          0 + (49 - num_ones) * 2);
-    }
-    else{ // Restrained
-        color_fill = emp::ColorRGB(
-          255 - (num_ones - 50) * 5,
-          255 - (num_ones - 50) * 5,
-          255 - (num_ones - 50) * 5);
-    }
-    canvas.Rect(
-      (cell_id % mc_size) * tile_width, 
-      (cell_id / mc_size) * tile_height,
-      tile_width, 
-      tile_height,
-      color_fill,
-      "#00000000"); // No edge lines!
+  // Start the worker; each frame it sends back is drawn onto the canvas (a cells_side square
+  // RGBA buffer, put into an offscreen canvas and scaled up without smoothing).  Frames from
+  // before the latest restart are dropped.
+  void StartWorker(){
+    EM_ASM({
+      const canvas = document.getElementById('canvas');
+      const offscreen = document.createElement('canvas');
+      window.emp_sr = { worker: new Worker('sr-worker.js'), generation: 0,
+                        busy: false, done: false };
+      emp_sr.worker.onmessage = function(e) {
+        const msg = e.data;
+        if (msg.generation != emp_sr.generation) return;
+        emp_sr.busy = false;
+        emp_sr.done = msg.done;
+        if (!msg.pixels) return;
+        offscreen.width = offscreen.height = msg.cells_side;
+        const image = new ImageData(new Uint8ClampedArray(msg.pixels), msg.cells_side, msg.cells_side);
+        offscreen.getContext('2d').putImageData(image, 0, 0);
+        const ctx = canvas.getContext('2d');
+        ctx.imageSmoothingEnabled = false;
+        ctx.drawImage(offscreen, 0, 0, canvas.width, canvas.height);
+      };
+    });
+  }
+  // Tell the worker to restart the multicell from a single cell with the current settings
+  void SetupWorker(){
+    EM_ASM({
+      emp_sr.generation++;
+      emp_sr.busy = true;
+      emp_sr.done = false;
+      emp_sr.worker.postMessage({ type: 'setup', generation: emp_sr.generation, cells_side: $0,
+                                  start_1s: $1, mut_prob: $2, one_check: $3 });
+    }, mc_size, (int) starting_ones, mut_prob, (int) one_check);
+  }
+  void ShowStopped(){
+    doc.Button("anim_toggle_btn").SetLabel("Start");
+    doc.Button("anim_toggle_btn").SetAttr("class", "btn btn-success");
   }
   // Called for every update of the animation. 
-  // If run_to_end is true, simulate the multicell until full, then draw
-  // Else, simulate steps_per_draw attempted cell reproductions and draw
+  // Unless the worker is still busy with the last frame, ask it for another: it simulates for
+  // frame_budget_ms and sends back the pixels (if run_to_end, only once the multicell is full).
   void DoFrame() override {
-    if(run_to_end){ 
-      while(multicell.num_cells < multicell.cells.size()){
-          multicell.DoStep();
-      }
-      for(size_t idx = 0; idx < mc_size * mc_size; ++idx){
-        DrawCell(idx);
-      }
+    if (EM_ASM_INT({ return emp_sr.done; })) { // We've finished! Stop the animation.
       Stop();
-      doc.Button("anim_toggle_btn").SetLabel("Start");
-      doc.Button("anim_toggle_btn").SetAttr("class", "btn btn-success");
-    }
-    else{
-      cells_to_draw_count = 0;
-      if(multicell.num_cells < multicell.cells.size()){
-        int actual_steps = steps_per_draw;
-        if(steps_per_draw == -1){
-          actual_steps = multicell.num_cells;
-        }
-        for(size_t step_id = 0; step_id < actual_steps; ++step_id){
-          multicell.DoStep();
-          if(multicell.cell_placed_last_step){
-            cells_to_draw[cells_to_draw_count++] = multicell.last_placed_cell_id;
-          }
-        }
-        for(size_t idx = 0; idx < cells_to_draw_count; ++idx){
-          DrawCell(cells_to_draw[idx]);
-        }
-      }
-      else{ // We've finished! Stop the animation and update the buttons
-        Stop();
-        doc.Button("anim_toggle_btn").SetLabel("Start");
-        doc.Button("anim_toggle_btn").SetAttr("class", "btn btn-success");
-      }
+      ShowStopped();
+      return;
     }
+    EM_ASM({
+      if (emp_sr.busy) return;
+      emp_sr.busy = true;
+      emp_sr.worker.postMessage({ type: 'advance', generation: emp_sr.generation,
+                                  budget_ms: $0, draw: !$1 });
+    }, frame_budget_ms, (int) run_to_end);
   }
   // Reset the simulation. Stop animation, restart the multicell from a single cell.
   void Reset(){
     Stop();
-    doc.Button("anim_toggle_btn").SetLabel("Start");
-    doc.Button("anim_toggle_btn").SetAttr("class", "btn btn-success");
-    multicell.SetupConfig();
-    auto canvas = doc.Canvas("canvas");
-    canvas.Clear("#000000");
-    multicell.InjectCell(mc_size / 2 +  mc_size * (mc_size / 2), starting_ones);
-    cells_to_draw.resize(0);
-    DrawCell(mc_size / 2 + mc_size * (mc_size / 2));
+    ShowStopped();
+    SetupWorker();
   }
   // Pull configuration options from the web page and apply them to the multicell
   void ApplyConfig(){
     mc_size = std::stoi(doc.Input("mc_size_input").GetCurrValue());
-    tile_width = canvas_width / mc_size;
-    tile_height = canvas_height / mc_size;
     starting_ones = std::stoi(doc.Input("ones_input").GetCurrValue());
     mut_prob = std::stod(doc.Input("mut_prob_input").GetCurrValue());
     std::string one_check_str = doc.Input("one_check_input").GetCurrValue();
     one_check = (one_check_str == "1" || one_check_str == "true");
-    multicell.mut_prob = mut_prob;
-    multicell.cells_side = mc_size;
-    multicell.restrain = 50;
-    multicell.genome_size = 100;
-    multicell.one_check = one_check;
-    multicell.SetupConfig();
   }
   // Create all the infrastructure to have an input with Bootstrap's input-group and add-on text
   // Returns div of input_group
@@ -192,7 +161,7 @@ protected:
     auto center = emp::web::Element("center", "");
     config_panel_body << center;
     center << emp::web::Button(
-      [this](){ Stop(); ApplyConfig(); Reset(); }, 
+      [this](){ ApplyConfig(); Reset(); }, 
       "Restart & Apply", "config_apply_btn").SetAttr("class", "btn btn-primary");
   }
   // Add the canvas and the widgets that directly control it. 
@@ -212,8 +181,8 @@ protected:
     canvas_panel_header << "<center><h3>Visualization</h3></center>";
     auto canvas_panel_body = emp::web::Div("canvas_panel_body").SetAttr("class", "panel-body");
     canvas_panel << canvas_panel_body;
+    // Frames are drawn by the worker's message handler, so the canvas is not an animation target.
     auto canvas = emp::web::Canvas(canvas_width, canvas_height, "canvas");
-    targets.push_back(canvas);
     canvas.SetCSS("display", "block");
     canvas.SetCSS("margin", "0 auto");
     canvas_panel_body << canvas;
@@ -236,15 +205,15 @@ protected:
     center << emp::web::Button([this](){ Reset(); }, "Reset Multicell", "anim_reset_btn")
       .SetAttr("class", "btn btn-warning");
     canvas_panel_body <<  "<br/>";
-    // Allow user to change the number of attempted cell births per render update
+    // Allow user to change how long the simulation runs between render updates
     auto form = emp::web::Element("form", "canvas_form");
     canvas_panel_body << form;
-    auto steps_input_group = AddInputGroup("steps", "Attempted cell births per draw (-1 for auto)",
+    auto budget_input_group = AddInputGroup("budget", "Simulation time per draw (ms)",
       "number", [this](const std::string & s){ 
-        steps_per_draw = std::stoi(s);
+        frame_budget_ms = std::stod(s);
     }); 
-    form << steps_input_group; 
-    doc.Input("steps_input").Value(steps_per_draw);
+    form << budget_input_group; 
+    doc.Input("budget_input").Value(frame_budget_ms);
     // Should we just simulate all the way to the end as one update?
     auto run_to_end_input_group = AddInputGroup("run_to_end",
       "Jump to end?", "checkbox", [this](const std::string & s){
@@ -255,10 +224,8 @@ protected:
   }
 public:
   RogueCellAnimationController():
-    doc("emp_base"),
-    multicell(random)
+    doc("emp_base")
   {
-    cells_to_draw.resize(512 * 512, 0); // Largest possible size
     // Setup the basics of bootstrap (overall container, jumbotron, etc.)
     auto container_div = doc.AddDiv("container_main").SetAttr("class", "container");
     auto header = emp::web::Div("header").SetAttr("class", "jumbotron");
@@ -274,10 +241,9 @@ public:
     AddConfigWidgets();
     // Reset all configuration options
     ApplyConfig();
-    multicell.SetupConfig();
-    // Insert and draw the first (center) cell!
-    multicell.InjectCell(mc_size / 2 +  mc_size * (mc_size / 2), starting_ones);
-    DrawCell(mc_size / 2 + mc_size * (mc_size / 2));
+    // Start the simulation and draw the first (center) cell!
+    StartWorker();
+    SetupWorker();
   }
 
 };
@@ -0,0 +1,54 @@
+/*
+ *  @copyright Copyright (C) Michigan State University, MIT Software license; see doc/LICENSE.md
+ *  @date 2022.
+ *
+ *  @file  SpatialRestraint-worker.cc
+ *  @brief Simulation half of the web app, run in a web worker (see web/sr-worker.js).
+ *  @note Status: BETA
+ *
+ *  Exposes a LiveMulticell through a handful of C functions.  The module has no DOM
+ *  dependencies, so it can also be driven headlessly under node, e.g.:
+ *
+ *    node -e "require('./SpatialRestraint-worker.js')().then(m => {
+ *      m._sr_setup(512, 55, 0.2, 0, 1); while (!m._sr_advance(100)); console.log(m._sr_time()); })"
+ */
+
+#include <emscripten.h>
+
+// Local
+#include "../LiveMulticell.h"
+
+LiveMulticell live_multicell;
+
+extern "C" {
+
+  /// Restart with the given settings (a seed of zero or less uses the time).
+  EMSCRIPTEN_KEEPALIVE void sr_setup(int cells_side, int start_1s, double mut_prob, int one_check,
+                                     int seed) {
+    live_multicell.SetSeed(seed);
+    Multicell & multicell = live_multicell.GetMulticell();
+    multicell.cells_side = cells_side;
+    multicell.restrain = 50;
+    multicell.genome_size = 100;
+    multicell.mut_prob = mut_prob;
+    multicell.one_check = one_check;
+    live_multicell.Restart(start_1s);
+  }
+
+  /// Simulate for up to budget_ms milliseconds; returns 1 once the multicell is full.
+  EMSCRIPTEN_KEEPALIVE int sr_advance(double budget_ms) {
+    live_multicell.Advance(budget_ms);
+    return live_multicell.IsDone();
+  }
+
+  /// The RGBA pixel buffer (cells_side x cells_side, row-major) and its size in bytes.
+  EMSCRIPTEN_KEEPALIVE const uint8_t * sr_pixels() { return live_multicell.GetPixels(); }
+  EMSCRIPTEN_KEEPALIVE int sr_pixel_bytes() { return (int) live_multicell.GetNumPixelBytes(); }
+
+  EMSCRIPTEN_KEEPALIVE int sr_num_cells() { return (int) live_multicell.GetMulticell().num_cells; }
+  EMSCRIPTEN_KEEPALIVE double sr_time() { return live_multicell.GetMulticell().cell_queue.GetTime(); }
+
+}
+
+int main(){
+}
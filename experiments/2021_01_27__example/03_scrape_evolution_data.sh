@@ -13,9 +13,10 @@ mkdir -p ${SR_EVO_DATA_DIR}
 SR_EVO_PLOT_DIR=${SR_EVO_DIR}/plots
 mkdir -p ${SR_EVO_PLOT_DIR}
 
-# Generate the list of raw evolution data files
+# Generate the list of raw evolution data files (slurm output of each job, or the log of each
+# job in a batch manifest)
 echo "Generating list of raw data files"
-find ${SR_EVO_OUTPUT_DIR} -name *__slurm.out | sort > ${SR_EVO_DATA_DIR}/raw_evolution_data_files.txt
+find ${SR_EVO_OUTPUT_DIR} \( -name '*__slurm.out' -o -name '*__job.out' \) | sort > ${SR_EVO_DATA_DIR}/raw_evolution_data_files.txt
 
 # Call RScript to scrape the data
 echo " "
@@ -42,6 +42,8 @@ parser.add_argument('@@time',            type=str, help='Time per jobs. Format:
         default = '2:00:00')
 parser.add_argument('@@samples_to_load', type=str, help='Samples to load if using -L', \
         default = '0->100')
+parser.add_argument('@@log_stride',      type=int, help='Generations between logged records ' + \
+        '(scraping only uses every SR_EVO_SCRAPE_GEN_STEP)', default = 1)
 parser.add_argument('@@memory',          type=str, help='Memory (typically gigs) per job. ' + \
         'Format: xG for x gigs', default = '1G')
 # mgilson at https://stackoverflow.com/questions/15008758/parsing-boolean-values-with-argparse
@@ -54,6 +56,10 @@ parser.set_defaults(infinite=False)
 parser.add_argument('@@enforce',     dest='enforce', action='store_true', help='Pass -e')
 parser.add_argument('@@no-enforce',  dest='enforce', action='store_false', help='Do not pass -e')
 parser.set_defaults(enforce=False)
+parser.add_argument('@@manifest',    dest='manifest', action='store_true', help='Write all ' + \
+        'runs to one manifest, run in batches with "batch", instead of one job per run')
+parser.add_argument('@@max_time',        type=str, help='Most time a batch may request with ' + \
+        '@@manifest (runs take @@time each). Format: D-HH:MM:SS', default = '7-00:00:00')
 
 
 args = parser.parse_args()
@@ -123,6 +129,8 @@ if args.infinite:
     extra_flags += ' -I'
 if args.enforce:
     extra_flags += ' -e'
+if args.log_stride > 1:
+    extra_flags += ' -O ' + str(args.log_stride)
 
 # This is a simple offset for the job id. If first batch is 0-1000, set this as 1000 to get 1000-2000
 job_id_start = args.seed_offset
@@ -144,6 +152,7 @@ max_samples_to_load = max(samples_to_load)
 
 num_jobs = 0
 cur_job_id = job_id_start
+manifest_lines = []
 # Iterate through each combination of configuration variables
 for condition_dict in combo_list:        
         num_jobs += 1
@@ -152,6 +161,41 @@ for condition_dict in combo_list:
         job_id_str = str(cur_job_id)
         job_id_str = '0' * (num_digits - len(job_id_str)) + job_id_str
         filename_prefix = job_id_str + '_spatial_restraint__' + combos.get_str(condition_dict)
+        command_str = executable_path
+        command_str += ' -a ' + str(condition_dict['ONES'])
+        command_str += ' -b ' + str(condition_dict['LENGTH'])
+        command_str += ' -c ' + str(condition_dict['MCSIZE'])
+        command_str += ' -g ' + str(condition_dict['GENS'])
+        command_str += ' -m ' + str(condition_dict['MUT'])
+        command_str += ' -r ' + str(condition_dict['THRESH'])
+        command_str += ' -E ' + output_dir + filename_prefix + \
+            '/${SLURM_ARRAY_TASK_ID}_evolution.dat'
+        command_str += ' -C ' + output_dir + filename_prefix + \
+            '/${SLURM_ARRAY_TASK_ID}_config.dat'
+        command_str += ' -s ' + str(condition_dict['SAMPLES'])
+        command_str += ' -d ' + str(condition_dict['REPS'])
+        command_str += ' -u ' + str(condition_dict['COST'])
+        command_str += ' -p ' + str(condition_dict['POP'])
+        command_str += ' -y ' + str(min_samples_to_load)
+        command_str += ' -z ' + str(max_samples_to_load)
+        command_str += ' -k ' + args.inf_mut_decrease_prob
+        command_str += ' -w ${RANDOM_SEED}' 
+        if(use_distribution_data):
+            command_str += ' -L ' + \
+                distribution_data_dir + \
+                'thresh__' + str(condition_dict['THRESH']) + '/' + \
+                'cell_mut__' + str(condition_dict['CELLMUT']) + '/' + \
+                'mcsize__' + str(condition_dict['MCSIZE']) + '/'
+        
+        command_str += ' ' + extra_flags + ' '
+        if args.manifest:
+            # One line per job, with the job's seed and task id filled in.  Its log (-v) goes
+            # to its own file, named like a job's slurm output, so it can still be scraped.
+            manifest_lines.append(command_str[len(executable_path):].strip() \
+                .replace('${SLURM_ARRAY_TASK_ID}', '1').replace('${RANDOM_SEED}', str(cur_job_id)) + \
+                ' > ' + output_dir + filename_prefix + '_1__job.out')
+            continue
+
         # Write slurm job file using current configuration options
         with open(job_dir + filename_prefix + '.sb', 'w') as fp_job:
             fp_job.write('#!/bin/bash --login' + '\n')
@@ -175,37 +219,13 @@ for condition_dict in combo_list:
             fp_job.write('' + '\n')
             fp_job.write('RANDOM_SEED=' + str(cur_job_id)+ '\n')
 
-            command_str = executable_path
-            command_str += ' -a ' + str(condition_dict['ONES'])
-            command_str += ' -b ' + str(condition_dict['LENGTH'])
-            command_str += ' -c ' + str(condition_dict['MCSIZE'])
-            command_str += ' -g ' + str(condition_dict['GENS'])
-            command_str += ' -m ' + str(condition_dict['MUT'])
-            command_str += ' -r ' + str(condition_dict['THRESH'])
-            command_str += ' -E ' + output_dir + filename_prefix + \
-                '/${SLURM_ARRAY_TASK_ID}_evolution.dat'
-            command_str += ' -C ' + output_dir + filename_prefix + \
-                '/${SLURM_ARRAY_TASK_ID}_config.dat'
-            command_str += ' -s ' + str(condition_dict['SAMPLES'])
-            command_str += ' -d ' + str(condition_dict['REPS'])
-            command_str += ' -u ' + str(condition_dict['COST'])
-            command_str += ' -p ' + str(condition_dict['POP'])
-            command_str += ' -y ' + str(min_samples_to_load)
-            command_str += ' -z ' + str(max_samples_to_load)
-            command_str += ' -k ' + args.inf_mut_decrease_prob
-            command_str += ' -w ${RANDOM_SEED}' 
-            if(use_distribution_data):
-                command_str += ' -L ' + \
-                    distribution_data_dir + \
-                    'thresh__' + str(condition_dict['THRESH']) + '/' + \
-                    'cell_mut__' + str(condition_dict['CELLMUT']) + '/' + \
-                    'mcsize__' + str(condition_dict['MCSIZE']) + '/'
-            
-            command_str += ' ' + extra_flags + ' '
-            
             fp_job.write('echo "' + command_str + '"\n')
             fp_job.write('time ' + command_str + '\n')
             fp_job.write('\n')
             fp_job.write('scontrol show job $SLURM_JOB_ID' + '\n')
 
+if args.manifest:
+    write_batch_job(job_dir, 'sr_evo', manifest_lines, executable_path, output_dir, args.time, \
+        args.memory, 'GCC/9.1.0-2.32', max_time = args.max_time)
+
 print('Generated ' +  str(num_jobs) + '!')
@@ -0,0 +1,50 @@
+'''Read binary column files written by SpatialRestraint with `-F binary`'''
+# Layout (little-endian): 8-byte magic "SRCOL1\0\0", uint32 column count, then for each column a
+# uint8 type (0 = int64, 1 = float64), uint32 name length and the name. The rest of the file is
+# blocks: a uint64 row count followed by that many 8-byte values for each column in turn.
+# See application/source/ColumnarIO.h for the writer.
+# Columns come back as array.array objects; numpy.asarray() wraps them without copying.
+import array, struct, sys
+
+MAGIC = b'SRCOL1\0\0'
+TYPES = {0: 'q', 1: 'd'}
+
+'''Load a column file into a dict of {column name: array of values}'''
+def read_columnar(filename):
+    with open(filename, 'rb') as fp:
+        data = fp.read()
+    if data[:8] != MAGIC:
+        print('Error!', filename, 'is not a column file')
+        exit(1)
+    pos = 8
+    num_cols, = struct.unpack_from('<I', data, pos)
+    pos += 4
+    table = {}
+    names = []
+    for col_id in range(num_cols):
+        col_type, name_len = struct.unpack_from('<BI', data, pos)
+        pos += 5
+        name = data[pos:pos + name_len].decode()
+        pos += name_len
+        names.append(name)
+        table[name] = array.array(TYPES[col_type])
+    while pos < len(data):
+        num_rows, = struct.unpack_from('<Q', data, pos)
+        pos += 8
+        for name in names:
+            table[name].frombytes(data[pos:pos + 8 * num_rows])
+            pos += 8 * num_rows
+    if sys.byteorder != 'little':
+        for name in names:
+            table[name].byteswap()
+    return table
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        print('Usage: python3 read_columnar.py <column file>')
+        exit(1)
+    table = read_columnar(sys.argv[1])
+    names = list(table.keys())
+    print(','.join(names))
+    for row in zip(*[table[name] for name in names]):
+        print(','.join(str(val) for val in row))
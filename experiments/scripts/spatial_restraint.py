@@ -0,0 +1,159 @@
+'''Run SpatialRestraint in-process through its C interface (build it with `make capi`)'''
+# The library is found at $SR_LIBRARY, or else application/bin/libSpatialRestraint.so in this repo.
+# See application/source/capi/SpatialRestraint-capi.h for what each call does.
+# Results are numpy arrays over memory owned by the library, so nothing is copied; each array
+# keeps its results object (and so that memory) alive for as long as it is in use.
+#
+# Example:
+#   import spatial_restraint as sr
+#   mc = sr.Multicell(cells_side=16, ancestor_1s=50)
+#   results = mc.run(100, seed=1)      # Same replicates as `SpatialRestraint -c 16 -d 100 -w 1`
+#   print(results.fill_times.mean())
+import ctypes, math, os
+import numpy as np
+
+LIBRARY = os.environ.get('SR_LIBRARY', os.path.join(os.path.dirname(os.path.abspath(__file__)),
+        '..', '..', 'application', 'bin', 'libSpatialRestraint.so'))
+API_VERSION = 1
+TRACE_COLUMNS = ['generation', 'ave_ones', 'ave_repro_time', 'min_ones', 'max_ones', 'var_ones']
+
+_lib = ctypes.CDLL(LIBRARY)
+_size_p = ctypes.POINTER(ctypes.c_size_t)
+_double_p = ctypes.POINTER(ctypes.c_double)
+_int_p = ctypes.POINTER(ctypes.c_int)
+for name, restype, argtypes in [
+        ('sr_api_version',               ctypes.c_int,    []),
+        ('sr_multicell_create',          ctypes.c_void_p, []),
+        ('sr_multicell_destroy',         None,            [ctypes.c_void_p]),
+        ('sr_multicell_set',             ctypes.c_int,    [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_double]),
+        ('sr_multicell_get',             ctypes.c_double, [ctypes.c_void_p, ctypes.c_char_p]),
+        ('sr_multicell_run',             ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_int]),
+        ('sr_results_destroy',           None,            [ctypes.c_void_p]),
+        ('sr_results_num_reps',          ctypes.c_size_t, [ctypes.c_void_p]),
+        ('sr_results_fill_times',        _double_p,       [ctypes.c_void_p]),
+        ('sr_results_repro_times',       _double_p,       [ctypes.c_void_p]),
+        ('sr_results_histogram',         _double_p,       [ctypes.c_void_p, _int_p, _size_p]),
+        ('sr_population_create',         ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_int, ctypes.c_size_t]),
+        ('sr_population_destroy',        None,            [ctypes.c_void_p]),
+        ('sr_population_load_samples',   ctypes.c_int,    [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_int]),
+        ('sr_population_evolve',         ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_double, ctypes.c_size_t, ctypes.c_int, ctypes.c_size_t]),
+        ('sr_trace_destroy',             None,            [ctypes.c_void_p]),
+        ('sr_trace_num_rows',            ctypes.c_size_t, [ctypes.c_void_p]),
+        ('sr_trace_data',                _double_p,       [ctypes.c_void_p]),
+        ('sr_trace_final_ones',          _int_p,          [ctypes.c_void_p, _size_p]),
+        ('sr_experiment_create',         ctypes.c_void_p, [ctypes.c_int, ctypes.POINTER(ctypes.c_char_p)]),
+        ('sr_experiment_destroy',        None,            [ctypes.c_void_p]),
+        ('sr_experiment_run',            None,            [ctypes.c_void_p]),
+        ('sr_experiment_num_treatments', ctypes.c_size_t, [ctypes.c_void_p]),
+        ('sr_experiment_results',        ctypes.c_void_p, [ctypes.c_void_p, ctypes.c_size_t])]:
+    func = getattr(_lib, name)
+    func.restype = restype
+    func.argtypes = argtypes
+if _lib.sr_api_version() != API_VERSION:
+    raise ImportError(LIBRARY + ' has C API version ' + str(_lib.sr_api_version()) +
+            '; expected ' + str(API_VERSION))
+
+'''Wrap count values of ctype at ptr as a numpy array (of shape, if given) that keeps owner alive'''
+def _wrap(ptr, ctype, count, owner, shape=None):
+    if count == 0:
+        return np.zeros(shape if shape else 0, dtype=ctype)
+    buf = (ctype * count).from_address(ctypes.addressof(ptr.contents))
+    buf._owner = owner
+    array = np.frombuffer(buf, dtype=ctype)
+    array.flags.writeable = False
+    return array.reshape(shape) if shape else array
+
+'''Handle to a library object, destroyed along with the last reference to it'''
+class _Handle:
+    _destroy = None
+    def __init__(self, ptr):
+        if not ptr:
+            raise ValueError('SpatialRestraint could not create ' + type(self).__name__)
+        self._ptr = ptr
+    def __del__(self):
+        if getattr(self, '_ptr', None):
+            type(self)._destroy(self._ptr)
+            self._ptr = None
+
+'''Fill times and final cell counts for a set of multicell replicates'''
+class MulticellResults(_Handle):
+    _destroy = _lib.sr_results_destroy
+    def __init__(self, ptr):
+        super().__init__(ptr)
+        num_reps = _lib.sr_results_num_reps(ptr)
+        min_ones = ctypes.c_int()
+        num_ones = ctypes.c_size_t()
+        hist_ptr = _lib.sr_results_histogram(ptr, ctypes.byref(min_ones), ctypes.byref(num_ones))
+        self.num_reps = num_reps
+        self.fill_times = _wrap(_lib.sr_results_fill_times(ptr), ctypes.c_double, num_reps, self)
+        self.repro_times = _wrap(_lib.sr_results_repro_times(ptr), ctypes.c_double, num_reps, self)
+        # Cells with each number of ones: one row per replicate, columns from min_ones up.
+        self.min_ones = min_ones.value
+        self.histogram = _wrap(hist_ptr, ctypes.c_double, num_reps * num_ones.value, self,
+                (num_reps, num_ones.value))
+
+'''Multicell settings (as in the executable's long options), and runs of replicates'''
+class Multicell(_Handle):
+    _destroy = _lib.sr_multicell_destroy
+    def __init__(self, **settings):
+        super().__init__(_lib.sr_multicell_create())
+        for name, value in settings.items():
+            self[name] = value
+    def __setitem__(self, name, value):
+        if _lib.sr_multicell_set(self._ptr, name.encode(), float(value)) != 0:
+            raise KeyError('Unknown multicell setting: ' + name)
+    def __getitem__(self, name):
+        value = _lib.sr_multicell_get(self._ptr, name.encode())
+        if math.isnan(value):
+            raise KeyError('Unknown multicell setting: ' + name)
+        return value
+    '''Run replicates 0 to num_reps-1 of a seed (-1 seeds randomly)'''
+    def run(self, num_reps, seed=-1):
+        ptr = _lib.sr_multicell_run(self._ptr, num_reps, seed)
+        if not ptr:
+            raise ValueError('Invalid multicell settings (cells_side must be a power of two, ' +
+                    'and endgame_empty cannot be combined with compact, approx_window or domain_threads)')
+        return MulticellResults(ptr)
+
+'''Per-generation records (one row per record; see TRACE_COLUMNS) and final ones of each org'''
+class Trace(_Handle):
+    _destroy = _lib.sr_trace_destroy
+    def __init__(self, ptr):
+        super().__init__(ptr)
+        num_rows = _lib.sr_trace_num_rows(ptr)
+        num_orgs = ctypes.c_size_t()
+        ones_ptr = _lib.sr_trace_final_ones(ptr, ctypes.byref(num_orgs))
+        self.data = _wrap(_lib.sr_trace_data(ptr), ctypes.c_double, num_rows * len(TRACE_COLUMNS),
+                self, (num_rows, len(TRACE_COLUMNS)))
+        self.final_ones = _wrap(ones_ptr, ctypes.c_int, num_orgs.value, self)
+    def __getitem__(self, column):
+        return self.data[:, TRACE_COLUMNS.index(column)]
+
+'''An evolving population of multicells; its sample cache is kept across calls to evolve()'''
+class Population(_Handle):
+    _destroy = _lib.sr_population_destroy
+    def __init__(self, multicell, pop_size=200, ancestor_1s=50, num_samples=100):
+        super().__init__(_lib.sr_population_create(multicell._ptr, pop_size, ancestor_1s, num_samples))
+    '''Load samples from a library directory (as with -L)'''
+    def load_samples(self, directory, min_ones, max_ones):
+        if _lib.sr_population_load_samples(self._ptr, directory.encode(), min_ones, max_ones) != 0:
+            raise FileNotFoundError(directory)
+    '''Evolve run run_id of a seed, recording every log_stride generations (0 for none)'''
+    # Matches the executable's run only after runs 0 to run_id-1 on this population (or, on a
+    # new population, with -i), since runs share the sample cache.
+    def evolve(self, num_gens, log_stride=1, seed=-1, run_id=0):
+        return Trace(_lib.sr_population_evolve(self._ptr, num_gens, log_stride, seed, run_id))
+
+'''A whole run of the executable, from its command-line arguments (without the program name)'''
+class Experiment(_Handle):
+    _destroy = _lib.sr_experiment_destroy
+    def __init__(self, args):
+        argv = [b'SpatialRestraint'] + [str(arg).encode() for arg in args]
+        super().__init__(_lib.sr_experiment_create(len(argv), (ctypes.c_char_p * len(argv))(*argv)))
+    def run(self):
+        _lib.sr_experiment_run(self._ptr)
+    def num_treatments(self):
+        return _lib.sr_experiment_num_treatments(self._ptr)
+    '''Replicates kept for a treatment of a multicell run'''
+    def results(self, combo_id):
+        return MulticellResults(_lib.sr_experiment_results(self._ptr, combo_id))
@@ -42,6 +42,10 @@ parser.set_defaults(one_check=True)
 parser.add_argument('@@infinite', dest='infinite', action='store_true', help='Pass -I')
 parser.add_argument('@@finite',   dest='infinite', action='store_false', help='Do not pass -I')
 parser.set_defaults(infinite=False)
+parser.add_argument('@@manifest', dest='manifest', action='store_true', help='Write all tasks ' + \
+        'to one manifest, run in batches with "batch", instead of one job per treatment')
+parser.add_argument('@@max_time',   type=str, help='Most time a batch may request with ' + \
+        '@@manifest (tasks take @@time each). Format: D-HH:MM:SS', default = '7-00:00:00')
 
 
 args = parser.parse_args()
@@ -119,6 +123,7 @@ num_digits = len(str(final_job_id))
 
 num_jobs = 0
 cur_job_id = job_id_start
+manifest_lines = []
 # Iterate through each combination of configuration variables
 for condition_dict in combo_list:        
     #for job_copy_id in range(job_copy_start, job_copy_stop):
@@ -128,6 +133,30 @@ for condition_dict in combo_list:
     job_id_str = str(cur_job_id)
     job_id_str = '0' * (num_digits - len(job_id_str)) + job_id_str
     filename_prefix = job_id_str + '_spatial_restraint__' + combos.get_str(condition_dict)
+    command_str = executable_path
+    command_str += ' -a ' + str(condition_dict['ONES'])
+    command_str += ' -b ' + str(condition_dict['LENGTH'])
+    command_str += ' -c ' + str(condition_dict['MCSIZE'])
+    command_str += ' -g ' + str(condition_dict['GENS'])
+    command_str += ' -m ' + str(condition_dict['MUT'])
+    command_str += ' -M ' + output_dir + filename_prefix + \
+        '/${SLURM_ARRAY_TASK_ID}_multicell.dat'
+    command_str += ' -C ' + output_dir + filename_prefix + \
+        '/${SLURM_ARRAY_TASK_ID}_config.dat'
+    command_str += ' -d ' + str(samples_per_task)
+    command_str += ' -u ' + str(condition_dict['COST'])
+    command_str += ' -r ' + str(condition_dict['THRESH'])
+    command_str += ' -k ' + args.inf_mut_decrease_prob
+    command_str += ' -w ${RANDOM_SEED}' 
+    command_str += ' ' + extra_flags + ' '
+    if args.manifest:
+        # One line per task, with each task's seed and id filled in
+        for task_id in range(1, tasks_per_job + 1):
+            manifest_lines.append(command_str[len(executable_path):].strip() \
+                .replace('${SLURM_ARRAY_TASK_ID}', str(task_id)) \
+                .replace('${RANDOM_SEED}', str(cur_job_id * tasks_per_job) + str(task_id)))
+        continue
+
     # Write slurm job file using current configuration options
     with open(job_dir + filename_prefix + '.sb', 'w') as fp_job:
         fp_job.write('#!/bin/bash --login' + '\n')
@@ -151,26 +180,13 @@ for condition_dict in combo_list:
         fp_job.write('' + '\n')
         fp_job.write('RANDOM_SEED=' + str(cur_job_id * tasks_per_job)+'${SLURM_ARRAY_TASK_ID}\n')
 
-        command_str = executable_path
-        command_str += ' -a ' + str(condition_dict['ONES'])
-        command_str += ' -b ' + str(condition_dict['LENGTH'])
-        command_str += ' -c ' + str(condition_dict['MCSIZE'])
-        command_str += ' -g ' + str(condition_dict['GENS'])
-        command_str += ' -m ' + str(condition_dict['MUT'])
-        command_str += ' -M ' + output_dir + filename_prefix + \
-            '/${SLURM_ARRAY_TASK_ID}_multicell.dat'
-        command_str += ' -C ' + output_dir + filename_prefix + \
-            '/${SLURM_ARRAY_TASK_ID}_config.dat'
-        command_str += ' -d ' + str(samples_per_task)
-        command_str += ' -u ' + str(condition_dict['COST'])
-        command_str += ' -r ' + str(condition_dict['THRESH'])
-        command_str += ' -k ' + args.inf_mut_decrease_prob
-        command_str += ' -w ${RANDOM_SEED}' 
-        command_str += ' ' + extra_flags + ' '
-        
         fp_job.write('echo "' + command_str + '"\n')
         fp_job.write('time ' + command_str + '\n')
         fp_job.write('\n')
         fp_job.write('scontrol show job $SLURM_JOB_ID' + '\n')
 
+if args.manifest:
+    write_batch_job(job_dir, 'sr_time', manifest_lines, executable_path, output_dir, args.time, \
+        args.memory, 'GCC/9.3.0', max_time = args.max_time)
+
 print('Generated ' +  str(num_jobs) + ', each with ' + str(tasks_per_job) + ' tasks!')
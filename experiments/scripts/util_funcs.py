@@ -1,3 +1,4 @@
+import os
 
 '''Convert a string containing integers to a Python list of ints'''
 # Format: 1,3,5->7,10 = [1,3,5,6,7,10]
@@ -37,6 +38,77 @@ def ensure_trailing_slash(s):
     return s
 
 
+'''Convert a slurm memory request (e.g. 1G, 500M, or plain megabytes) to megabytes'''
+def memory_to_mb(s):
+    units = {'K': 1 / 1024, 'M': 1, 'G': 1024, 'T': 1024 * 1024}
+    if s[-1].upper() in units:
+        return int(float(s[:-1]) * units[s[-1].upper()])
+    return int(s)
+
+
+'''Convert a slurm time (MM, MM:SS, HH:MM:SS, D-HH, D-HH:MM or D-HH:MM:SS) to seconds'''
+def time_to_seconds(s):
+    days = 0
+    if '-' in s:
+        days, s = s.split('-')
+        parts = [int(x) for x in s.split(':')]
+        parts += [0] * (3 - len(parts))                 # D-HH or D-HH:MM
+    else:
+        parts = [int(x) for x in s.split(':')]
+        if len(parts) < 3:                              # MM or MM:SS
+            parts = [0] + parts + [0] * (2 - len(parts))
+    hours, minutes, seconds = parts
+    return ((int(days) * 24 + hours) * 60 + minutes) * 60 + seconds
+
+'''Convert seconds to a slurm time (D-HH:MM:SS)'''
+def seconds_to_time(seconds):
+    return '%d-%02d:%02d:%02d' % (seconds // 86400, seconds // 3600 % 24, seconds // 60 % 60, \
+        seconds % 60)
+
+
+'''Write a manifest of runs, one per line, and a slurm array job that runs them in batches'''
+# Each line holds the options for one run (everything after the executable); outputs still go to
+# each run's own files (a line ending in "> FILE" also sends the run's standard output there; the
+# batch's own output is not named *__slurm.out, so it is never scraped as a run's).  Sample
+# libraries loaded with -L are only read once per batch.
+# Runs in a batch go one after another, so each batch gets time (what one run needs) for each of
+# its runs; the manifest is split into as many batches (array tasks) as it takes for none to
+# need more than max_time.
+# Unlike separate jobs, a batch keeps those libraries in memory between runs, up to
+# sample_cache_mb (least recently used ones are dropped past that), so each task requests memory
+# (what one run needs) plus sample_cache_mb.
+def write_batch_job(job_dir, job_name, manifest_lines, executable_path, output_dir, time, memory, \
+        gcc_module, sample_cache_mb = 512, max_time = '7-00:00:00'):
+    runs_per_batch = max(1, time_to_seconds(max_time) // time_to_seconds(time))
+    num_batches = (len(manifest_lines) + runs_per_batch - 1) // runs_per_batch
+    runs_per_batch = (len(manifest_lines) + num_batches - 1) // num_batches   # Even them out.
+    for batch_id in range(num_batches):
+        with open(job_dir + job_name + '_manifest_' + str(batch_id + 1) + '.txt', 'w') as fp_manifest:
+            for line in manifest_lines[batch_id * runs_per_batch:(batch_id + 1) * runs_per_batch]:
+                fp_manifest.write(line + '\n')
+    manifest_path = job_dir + job_name + '_manifest_${SLURM_ARRAY_TASK_ID}.txt'
+    with open(job_dir + job_name + '_batch.sb', 'w') as fp_job:
+        fp_job.write('#!/bin/bash --login' + '\n')
+        fp_job.write('' + '\n')
+        fp_job.write('#SBATCH --time=' + seconds_to_time(time_to_seconds(time) * runs_per_batch) + '\n')
+        fp_job.write('#SBATCH --nodes=1' + '\n')
+        fp_job.write('#SBATCH --ntasks=1' + '\n')
+        fp_job.write('#SBATCH --cpus-per-task=1' + '\n')
+        fp_job.write('#SBATCH --mem-per-cpu=' + str(memory_to_mb(memory) + sample_cache_mb) + 'M' + '\n')
+        fp_job.write('#SBATCH --job-name ' + job_name + '_batch' + '\n')
+        fp_job.write('#SBATCH --array=1-' + str(num_batches) + '\n')
+        fp_job.write('#SBATCH --output=' + output_dir + job_name + '_batch_%a.out' + '\n')
+        fp_job.write('' + '\n')
+        fp_job.write('module purge' + '\n')
+        fp_job.write('module load ' + gcc_module + '\n')
+        fp_job.write('' + '\n')
+        fp_job.write('time ' + executable_path + ' batch ' + os.path.abspath(manifest_path) + ' ' + \
+                str(sample_cache_mb) + '\n')
+        fp_job.write('\n')
+        fp_job.write('scontrol show job $SLURM_JOB_ID' + '\n')
+    print('Wrote', len(manifest_lines), 'runs to', num_batches, 'batches of up to', runs_per_batch, \
+        'in', job_dir + job_name + '_manifest_*.txt')
+
 if __name__ == '__main__':
     # Test ints
     L1 = str_to_int_list('1,2,3')
@@ -69,5 +141,15 @@ if __name__ == '__main__':
     if(s2 != 'foo/'):
         print('Error! Expected: foo/  Received:', s2)
         exit()
+    # Slurm time tests
+    for t, secs in [('30', 1800), ('30:15', 1815), ('2:00:00', 7200), ('1-02', 93600), \
+            ('1-02:30', 95400), ('7-00:00:00', 604800)]:
+        if(time_to_seconds(t) != secs):
+            print('Error! Expected:', secs, 'Received:', time_to_seconds(t), 'for', t)
+            exit()
+    t1 = seconds_to_time(95415)
+    if(t1 != '1-02:30:15'):
+        print('Error! Expected: 1-02:30:15  Received:', t1)
+        exit()
     
     print('All tests pass!')
@@ -0,0 +1,45 @@
+// Web worker running the simulation for the web app (built from SpatialRestraint-worker.cc).
+//
+// Messages in:  {type: 'setup', generation, cells_side, start_1s, mut_prob, one_check}
+//               {type: 'advance', generation, budget_ms, draw}
+// Messages out: {generation, cells_side, num_cells, time, done, pixels}
+// pixels is the RGBA buffer (cells_side x cells_side, transferred), or null for an 'advance'
+// without draw that did not finish the multicell.
+
+importScripts('SpatialRestraint-worker.js');
+
+let sim = null;
+const waiting = [];   // Messages that arrived before the module was ready.
+
+function PostFrame(generation, done, draw) {
+  let pixels = null;
+  if (draw || done) {
+    const ptr = sim._sr_pixels();
+    pixels = sim.HEAPU8.slice(ptr, ptr + sim._sr_pixel_bytes()).buffer;
+  }
+  postMessage({ generation: generation, cells_side: Math.sqrt(sim._sr_pixel_bytes() / 4),
+                num_cells: sim._sr_num_cells(), time: sim._sr_time(), done: done,
+                pixels: pixels }, pixels ? [pixels] : []);
+}
+
+function Handle(msg) {
+  if (msg.type == 'setup') {
+    sim._sr_setup(msg.cells_side, msg.start_1s, msg.mut_prob, msg.one_check ? 1 : 0, 0);
+    PostFrame(msg.generation, false, true);
+  }
+  else if (msg.type == 'advance') {
+    const done = sim._sr_advance(msg.budget_ms) != 0;
+    PostFrame(msg.generation, done, msg.draw);
+  }
+}
+
+onmessage = function(e) {
+  if (sim) Handle(e.data);
+  else waiting.push(e.data);
+};
+
+SpatialRestraintWorker().then(function(module) {
+  sim = module;
+  waiting.forEach(Handle);
+  waiting.length = 0;
+});